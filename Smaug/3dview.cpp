@@ -1,6 +1,7 @@
 #include "3dview.h"
 
 #include "worldrenderer.h"
+#include "worldeditor.h"
 #include "shadermanager.h"
 #include "smaugapp.h"
 #include "utils.h"
@@ -39,6 +40,8 @@ END_SVAR_TABLE()
 static C3DViewSettings s_3dViewSettings;
 DEFINE_SETTINGS_MENU("3D View", s_3dViewSettings);
 
+#define PREVIEW_FAR_PLANE 800.0f
+
 
 void C3DView::Init(bgfx::ViewId viewId, int width, int height, uint32_t clearColor)
 {
@@ -54,15 +57,32 @@ void C3DView::Draw(float dt)
 {
 	CBaseView::Draw(dt);
 
-	glm::vec3 forwardDir;
-	Directions(m_cameraAngle, &forwardDir);
+	glm::vec3 forwardDir, rightDir, upDir;
+	Directions(m_cameraAngle, &forwardDir, &rightDir, &upDir);
 
 
+	float fov = glm::radians(s_3dViewSettings.viewFOV.GetValue());
 	glm::mat4 view = glm::lookAt(m_cameraPos, m_cameraPos + forwardDir, { 0,1,0 });
-	glm::mat4 proj = glm::perspective(glm::radians(s_3dViewSettings.viewFOV.GetValue()), m_aspectRatio, 0.1f, 800.0f);
+	glm::mat4 proj = glm::perspective(fov, m_aspectRatio, 0.1f, PREVIEW_FAR_PLANE);
 	bgfx::setViewTransform(m_viewId, &view[0][0], &proj[0][0]);
 
-	GetWorldRenderer().Draw3D(m_viewId, Shader::WORLD_PREVIEW_SHADER);
+	// Everything we can see is inside the pyramid from the camera out to the far plane. Box that up
+	float farHeight = tanf(fov / 2.0f) * PREVIEW_FAR_PLANE;
+	float farWidth = farHeight * m_aspectRatio;
+	aabb_t viewBox = { m_cameraPos, m_cameraPos };
+	for (float x : { -farWidth, farWidth })
+		for (float y : { -farHeight, farHeight })
+			viewBox = addPointToAABB(viewBox, m_cameraPos + forwardDir * PREVIEW_FAR_PLANE + rightDir * x + upDir * y);
+
+	std::vector<CNode*> visible;
+	GetWorldEditor().m_bvh.FindInBox(viewBox, { 1, 1, 1 }, [&](CNode* node)
+	{
+		if (node->IsVisible())
+			visible.push_back(node);
+	});
+	GetWorldEditor().Materialise(visible);
+
+	GetWorldRenderer().Draw3D(m_viewId, Shader::WORLD_PREVIEW_SHADER, visible);
 	
 	//Grid().Draw();
 
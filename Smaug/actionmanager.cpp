@@ -4,6 +4,8 @@
 #include "cursor.h"
 #include "raytest.h"
 
+#include <algorithm>
+
 
 glm::vec3 GetSelectionPos(selectionInfo_t info)
 {
@@ -62,6 +64,44 @@ glm::vec3 SolvePosToSelection(selectionInfo_t info, glm::vec3 pos, SolveToLine2D
 	return glm::vec3(0.0f, 0.0f, 0.0f);
 }
 
+void CSelectionSet::Clear()
+{
+	m_nodes.clear();
+	m_parts.clear();
+	m_verts.clear();
+}
+
+bool CSelectionSet::AddNode(CNodeRef node) { return m_nodes.insert(Key(node)).second; }
+bool CSelectionSet::AddPart(CNodeRef node, meshId_t part) { return m_parts.insert(Key(node, part)).second; }
+bool CSelectionSet::AddVert(CNodeRef node, meshId_t part, meshId_t vert) { return m_verts.insert(Key(node, part, vert)).second; }
+
+std::vector<CNodeRef> CSelectionSet::Nodes()
+{
+	std::vector<CNodeRef> nodes;
+	nodes.reserve(m_nodes.size());
+	for (auto& k : m_nodes)
+		nodes.push_back(k.node);
+	return nodes;
+}
+
+std::vector<CNodeMeshPartRef> CSelectionSet::Parts()
+{
+	std::vector<CNodeMeshPartRef> parts;
+	parts.reserve(m_parts.size());
+	for (auto& k : m_parts)
+		parts.push_back(CNodeMeshPartRef(k.node, k.part));
+	return parts;
+}
+
+std::vector<CNodeVertexRef> CSelectionSet::Verts()
+{
+	std::vector<CNodeVertexRef> verts;
+	verts.reserve(m_verts.size());
+	for (auto& k : m_verts)
+		verts.push_back(CNodeVertexRef(CNodeMeshPartRef(k.node, k.part), k.vert));
+	return verts;
+}
+
 CActionManager& GetActionManager()
 {
 	static CActionManager actionManager;
@@ -80,10 +120,44 @@ void CActionManager::CommitAction(IAction* action)
 	m_redoStack.clear();
 }
 
+// How close the mouse has to be to a vert to pick it
+#define FIND_VERT_DISTANCE 4.0f
+// How close the mouse has to be to a side to pick it. We want to allow for a lot more grab room within the node. Prevents mistakes from being made.
+#define FIND_SIDE_INSIDE_DISTANCE 2.0f
+#define FIND_SIDE_OUTSIDE_DISTANCE 1.0f
+// Sides facing along the working axis more than this are floors and ceilings. Can't grab those
+#define FIND_SIDE_MAX_AXIS_DOT 0.89f
+
+// Size of the cells hovers are cached by. Way under any pick distance, so reusing a result within one is never noticeable
+#define HOVER_CACHE_CELL (1.0f / 32.0f)
+
 bool CActionManager::FindFlags(glm::vec3 mousePos, selectionInfo_t& info, int findFlags, glm::vec3* outPointOfIntersect)
 {
+	// Tools ask every frame, even when nothing's moved. Hand back what we found last time if nothing's changed since
+	glm::ivec3 mouseCell = glm::ivec3(glm::floor(mousePos / HOVER_CACHE_CELL));
+	glm::vec3 workingAxis = GetCursor().GetWorkingAxis();
+	uint32_t editEpoch = GetWorldEditor().m_editEpoch;
+
+	hoverCache_t& c = m_hoverCache;
+	if (!c.valid || c.mouseCell != mouseCell || c.workingAxis != workingAxis || c.findFlags != findFlags || c.editEpoch != editEpoch)
+	{
+		c.valid = true;
+		c.mouseCell = mouseCell;
+		c.workingAxis = workingAxis;
+		c.findFlags = findFlags;
+		c.editEpoch = editEpoch;
+		c.pointOfIntersect = { 0, 0, 0 };
+		c.found = FindFlagsUncached(mousePos, c.info, findFlags, &c.pointOfIntersect);
+	}
 
+	info = c.info;
+	if (c.found && outPointOfIntersect)
+		*outPointOfIntersect = c.pointOfIntersect;
+	return c.found;
+}
 
+bool CActionManager::FindFlagsUncached(glm::vec3 mousePos, selectionInfo_t& info, int findFlags, glm::vec3* outPointOfIntersect)
+{
 	// If this isn't 0, ACT_SELECT_NONE, we might have issues down the line
 	info.selected = ACT_SELECT_NONE;
 
@@ -95,13 +169,20 @@ bool CActionManager::FindFlags(glm::vec3 mousePos, selectionInfo_t& info, int fi
 	glm::vec3 workingAxis = GetCursor().GetWorkingAxis();
 	glm::vec3 workingAxisMask = GetCursor().GetWorkingAxisMask();
 
+	// The mouse gets pushed onto a side along its normal. The more a side slopes, the further that push can go and still land in range
+	float sideReach = FIND_SIDE_INSIDE_DISTANCE / sqrtf(1.0f - FIND_SIDE_MAX_AXIS_DOT * FIND_SIDE_MAX_AXIS_DOT);
+	float faceBloat = (findFlags & ACT_SELECT_VERT ? std::max(sideReach, FIND_VERT_DISTANCE) : sideReach) + 0.01f;
+
+	// Verts beat sides, and sides beat bare nodes. Past that, closest to the mouse wins
+	int bestRank = 0;
+	float bestDistance = FLT_MAX;
 	glm::vec3 pointOfIntersect = {0, 0, 0};
 
-	// Find the selected item
-	for (auto p : GetWorldEditor().m_nodes)
+	std::vector<meshPart_t*> parts;
+
+	// Only the nodes in the column under the mouse
+	GetWorldEditor().m_bvh.FindInColumn(mousePos, workingAxisMask, 1.5f, [&](CNode* node)
 	{
-		CNode* node = p.second;
-		
 		// Put the mouse on level with the node
 		glm::vec3 localMouse = mousePos - node->Origin();
 		localMouse *= workingAxisMask; // Flatten it out to just this plane
@@ -110,129 +191,253 @@ bool CActionManager::FindFlags(glm::vec3 mousePos, selectionInfo_t& info, int fi
 
 		// Check if we're in the AABB
 		if (!testPointInAABB(localMouse, aabb, 1.5f))
-			continue; // Not in bounds!
-		
-//		printf("IN BOUND");
-		
-					  
+			return; // Not in bounds!
+
+		// Only parts with a collision face near the mouse could have a vert or side close enough
+		parts.clear();
+		if (findFlags & (ACT_SELECT_VERT | ACT_SELECT_SIDE | ACT_SELECT_WALL))
+		{
+			node->CollisionBVH().FindAtPoint(localMouse, faceBloat, [&](face_t* f, meshPart_t* part)
+			{
+				if (std::find(parts.begin(), parts.end(), part) == parts.end())
+					parts.push_back(part);
+				return false;
+			});
+		}
+
 		// Do we want vertex selecting?
+		vertex_t* vert = nullptr;
+		float vertDistance = FLT_MAX;
 		if (findFlags & ACT_SELECT_VERT)
 		{
 			// Corner check
-			//for (int j = 0; j < node->m_sideCount; j++)
-			for (auto p : node->m_mesh.parts)
+			for (auto p : parts)
 			{
-
 				for (auto v : p->verts)
 				{
-					if (glm::distance(*v->vert, localMouse) <= 4
-					 && glm::distance(*v->edge->vert->vert, localMouse) <= 4)
+					float distance = glm::distance(*v->vert, localMouse);
+					if (distance <= FIND_VERT_DISTANCE && distance < vertDistance
+					 && glm::distance(*v->edge->vert->vert, localMouse) <= FIND_VERT_DISTANCE)
 					{
-						// Got a point. Add the flag and break the loop.
-						info.selected |= ACT_SELECT_VERT;
-						info.vertex = { v, node };
-						break;
+						vert = v;
+						vertDistance = distance;
 					}
 				}
 			}
 		}
 
-		if (findFlags & ACT_SELECT_WALL || findFlags & ACT_SELECT_SIDE)
+		meshPart_t* side = nullptr;
+		float sideDistance = FLT_MAX;
+		glm::vec3 sideIntersect;
+		if (findFlags & ACT_SELECT_SIDE)
 		{
-			bool foundSomething = false;
-			// Side's walls check
-			for (auto p : node->m_mesh.parts)
+			for (auto p : parts)
 			{
-				// Are we on the side?
-				//mousePos.y = node->Origin().y;
+				// Discard parts with norms we don't like, or that are too far off, before bothering with the outline
+				if (fabs(glm::dot(p->normal, workingAxis)) > FIND_SIDE_MAX_AXIS_DOT)
+					continue;
+				if (fabs(glm::dot(p->normal, localMouse) - p->planeDist) > sideReach)
+					continue;
 
+				// Are we on the side?
 				testRayPlane_t t = pointOnPartLocal(p, localMouse);
-				glm::vec3 norm = glm::normalize(t.normal);
+				if (!t.hit)
+					continue;
 
-				// We want to allow for a lot more grab room within the node. Prevents mistakes from being made.
-				float threshold = glm::dot(norm, localMouse - t.intersect) > 0 ? 2 : 1;
+				float threshold = glm::dot(t.normal, localMouse - t.intersect) > 0 ? FIND_SIDE_INSIDE_DISTANCE : FIND_SIDE_OUTSIDE_DISTANCE;
+				float distance = glm::distance(t.intersect * workingAxisMask, localMouse * workingAxisMask);
 
-				if (t.hit && glm::distance(t.intersect * workingAxisMask, localMouse * workingAxisMask) <= threshold)
+				if (distance <= threshold && distance < sideDistance)
 				{
-					// Discard parts with norms we don't like
-					// TODO: Do this earlier! Ideally before the ray test!
-					if (fabs(glm::dot(norm, workingAxis)) > 0.89)
-					{
-						//printf("Skip\n");
-						continue;
-					}
-					//printf("HIT\n");
+					side = p;
+					sideDistance = distance;
+					sideIntersect = t.intersect;
+				}
+			}
+		}
 
-					if (findFlags & ACT_SELECT_SIDE)
-					{
-						info.selected |= ACT_SELECT_SIDE;
-						info.side = { p, node };
-						
-						foundSomething = true;
-					}
+		// How does this node stack up?
+		int rank = 0;
+		float distance = FLT_MAX;
+		if (vert)
+		{
+			rank = 3;
+			distance = vertDistance;
+		}
+		else if (side)
+		{
+			rank = 2;
+			distance = sideDistance;
+		}
+		else if (findFlags & ACT_SELECT_NODE)
+		{
+			// They just want a node
+			rank = 1;
+			distance = glm::distance(mousePos * workingAxisMask, (node->Origin() + (aabb.min + aabb.max) / 2.0f) * workingAxisMask);
+		}
 
-					/*
-					if (findFlags & ACT_SELECT_WALL)
-					{
-						// Which wall are we selecting?
-						for(auto f : p->faces)
-						{
-							if (f->verts.size() == 3)
-							{
-								if (testPointInTri(mousePos, *f->verts[0]->vert, *f->verts[1]->vert, *f->verts[2]->vert))
-								{
-
-									info.selected |= ACT_SELECT_WALL;
-									info.wall = f;
-
-									// If they're asking for a wall, they're going to want a side too
-									info.side = p;
-
-									foundSomething = true;
-									break;
-								}
-							}
-						}
-					}
-					*/
+		if (rank == 0 || rank < bestRank || (rank == bestRank && distance >= bestDistance))
+			return;
 
-					if (foundSomething)
-					{
-						pointOfIntersect = t.intersect + node->Origin();
-						break;
-					}
-				}
+		bestRank = rank;
+		bestDistance = distance;
 
-			}
+		// We almost always need the node anyway
+		info.selected = ACT_SELECT_NODE;
+		info.node = node;
+
+		if (vert)
+		{
+			info.selected |= ACT_SELECT_VERT;
+			info.vertex = { vert, node };
 		}
 
-		// Did we find something?
-		if (info.selected != ACT_SELECT_NONE)
+		pointOfIntersect = {0, 0, 0};
+		if (side)
 		{
-			// We almost always need the node anyway
-			info.selected |= ACT_SELECT_NODE;
-			info.node = node;
+			info.selected |= ACT_SELECT_SIDE;
+			info.side = { side, node };
+			pointOfIntersect = sideIntersect + node->Origin();
+		}
+	});
 
-			if (outPointOfIntersect)
-				*outPointOfIntersect = pointOfIntersect;
+	// Did we find something?
+	if (info.selected == ACT_SELECT_NONE)
+		return false;
 
-			// We got our selected item(s). Let's dip
+	if (outPointOfIntersect)
+		*outPointOfIntersect = pointOfIntersect;
+
+	return true;
+}
+
+int CActionManager::FindInRegion(const std::vector<glm::vec3>& region, CSelectionSet& selection, int findFlags)
+{
+	if (region.size() < 2 || findFlags == ACT_SELECT_NONE)
+		return 0;
+
+	glm::vec3 workingAxis = GetCursor().GetWorkingAxis();
+	glm::vec3 workingAxisMask = GetCursor().GetWorkingAxisMask();
+
+	// The two axes of the working plane
+	int u = -1, v = -1;
+	for (int i = 0; i < 3; i++)
+	{
+		if (workingAxisMask[i] == 0)
+			continue;
+		if (u == -1)
+			u = i;
+		else
+			v = i;
+	}
+	if (v == -1)
+		return 0;
+
+	aabb_t bounds = { region[0], region[0] };
+	for (auto p : region)
+		bounds = aabbUnion(bounds, { p, p });
+
+	// Boxes are done once we know we're in bounds. Lassos still need to count how many times we cross their outline
+	bool box = region.size() == 2;
+	auto inRegion = [&](glm::vec3 p)
+	{
+		if (p[u] < bounds.min[u] || p[u] > bounds.max[u] || p[v] < bounds.min[v] || p[v] > bounds.max[v])
+			return false;
+		if (box)
 			return true;
+
+		bool inside = false;
+		for (size_t i = 0, j = region.size() - 1; i < region.size(); j = i++)
+		{
+			glm::vec3 a = region[i];
+			glm::vec3 b = region[j];
+			if ((a[v] > p[v]) != (b[v] > p[v]) && p[u] < a[u] + (p[v] - a[v]) / (b[v] - a[v]) * (b[u] - a[u]))
+				inside = !inside;
 		}
-		else if (findFlags & ACT_SELECT_NODE)
+		return inside;
+	};
+
+	int added = 0;
+
+	// Only the nodes under the region's bounds
+	GetWorldEditor().m_bvh.FindInBox(bounds, workingAxisMask, [&](CNode* node)
+	{
+		glm::vec3 origin = node->Origin();
+		aabb_t aabb = node->GetLocalAABB();
+
+		if ((findFlags & ACT_SELECT_NODE) && inRegion(origin + (aabb.min + aabb.max) / 2.0f))
+			added += selection.AddNode(node);
+
+		if (!(findFlags & (ACT_SELECT_SIDE | ACT_SELECT_VERT)))
+			return;
+
+		// Part normals only get worked out once the node's shaped
+		GetWorldEditor().MaterialiseShape(node);
+
+		// Parts share verts along their edges. Each one only gets added through the first part that has it
+		std::unordered_set<glm::vec3*> seenVerts;
+
+		std::vector<meshPart_t*>& parts = node->m_mesh.parts;
+		for (size_t pi = 0; pi < parts.size(); pi++)
 		{
-			// They just want a node
-			info.selected |= ACT_SELECT_NODE;
-			info.node = node;
+			meshPart_t* p = parts[pi];
+
+			// Same as FindFlags, no floors or ceilings
+			if ((findFlags & ACT_SELECT_SIDE)
+			 && fabs(glm::dot(p->normal, workingAxis)) <= FIND_SIDE_MAX_AXIS_DOT
+			 && inRegion(origin + faceCenter(p)))
+				added += selection.AddPart(node, pi);
+
+			if (findFlags & ACT_SELECT_VERT)
+				for (size_t vi = 0; vi < p->verts.size(); vi++)
+					if (seenVerts.insert(p->verts[vi]->vert).second && inRegion(origin + *p->verts[vi]->vert))
+						added += selection.AddVert(node, pi, vi);
+		}
+	});
 
-			if (outPointOfIntersect)
-				*outPointOfIntersect = pointOfIntersect;
+	return added;
+}
 
-			return true;
+bool CActionManager::FindNearestVert(glm::vec3 pos, float maxDistance, CNodeRef ignore, glm::vec3& outVert)
+{
+	glm::vec3 workingAxisMask = GetCursor().GetWorkingAxisMask();
+
+	bool found = false;
+	float bestDistance = maxDistance;
+	GetWorldEditor().m_bvh.FindNearest(pos, workingAxisMask, maxDistance, [&](CNode* node)
+	{
+		if (node->Ref() == ignore)
+			return FLT_MAX;
+
+		// Every vert's in here once, no matter how many parts share it
+		// Packed nodes still have all their verts, so there's no need to unpack them just to snap
+		float nodeDistance = FLT_MAX;
+		auto checkVert = [&](glm::vec3& v)
+		{
+			glm::vec3 p = node->Origin() + v;
+			float distance = glm::length((p - pos) * workingAxisMask);
+			nodeDistance = std::min(nodeDistance, distance);
+			if (distance <= bestDistance)
+			{
+				found = true;
+				bestDistance = distance;
+				outVert = p;
+			}
+		};
+		if (node->IsPacked())
+		{
+			for (auto& v : node->m_packedMesh.verts)
+				checkVert(v);
 		}
-	}
+		else
+		{
+			for (auto v : node->m_mesh.verts)
+				checkVert(*v);
+		}
+		return nodeDistance;
+	});
 
-	return false;
+	return found;
 }
 
 void CActionManager::Undo()
@@ -265,6 +470,9 @@ void CActionManager::Clear()
 		delete a;
 	m_actionHistory.clear();
 	m_redoStack.clear();
+
+	// The world's being thrown out, and its ids get handed out again from scratch
+	m_selection.Clear();
 }
 
 void CActionManager::Update()
@@ -3,6 +3,8 @@
 #include <glm/glm.hpp>
 #include "worldeditor.h"
 #include <typeinfo>
+#include <unordered_set>
+#include <vector>
 
 #define ACT_SELECT_NONE 0
 #define ACT_SELECT_NODE	1
@@ -19,6 +21,58 @@ struct selectionInfo_t
 	//face_t* wall = nullptr;
 };
 
+// Everything picked up by a box or lasso select
+// Nodes, parts and verts are kept by their ids, so adding and checking for them is just a hash
+class CSelectionSet
+{
+public:
+	void Clear();
+	bool Empty() { return m_nodes.empty() && m_parts.empty() && m_verts.empty(); }
+
+	// These return false if it was already in the set
+	bool AddNode(CNodeRef node);
+	bool AddPart(CNodeRef node, meshId_t part);
+	bool AddVert(CNodeRef node, meshId_t part, meshId_t vert);
+
+	bool HasNode(CNodeRef node) { return m_nodes.contains(Key(node)); }
+	bool HasPart(CNodeRef node, meshId_t part) { return m_parts.contains(Key(node, part)); }
+	bool HasVert(CNodeRef node, meshId_t part, meshId_t vert) { return m_verts.contains(Key(node, part, vert)); }
+
+	size_t NodeCount() { return m_nodes.size(); }
+	size_t PartCount() { return m_parts.size(); }
+	size_t VertCount() { return m_verts.size(); }
+
+	// Refs are built right off of the ids. No searching through the meshes for them
+	std::vector<CNodeRef> Nodes();
+	std::vector<CNodeMeshPartRef> Parts();
+	std::vector<CNodeVertexRef> Verts();
+
+private:
+	struct key_t
+	{
+		CNodeRef node;
+		meshId_t part;
+		meshId_t vert;
+
+		bool operator==(const key_t& k) const { return node == k.node && part == k.part && vert == k.vert; }
+	};
+
+	struct keyHash_t
+	{
+		size_t operator()(const key_t& k) const
+		{
+			std::hash<uint64_t> hasher;
+			return std::hash<CNodeRef>()(k.node) ^ hasher((uint64_t)k.part << 32 | k.vert) * 31;
+		}
+	};
+
+	static key_t Key(CNodeRef node, meshId_t part = INVALID_MESH_ID, meshId_t vert = INVALID_MESH_ID) { return { node, part, vert }; }
+
+	std::unordered_set<key_t, keyHash_t> m_nodes;
+	std::unordered_set<key_t, keyHash_t> m_parts;
+	std::unordered_set<key_t, keyHash_t> m_verts;
+};
+
 enum class SolveToLine2DSnap;
 glm::vec3 GetSelectionPos(selectionInfo_t info);
 glm::vec3 SolvePosToSelection(selectionInfo_t info, glm::vec3 pos, SolveToLine2DSnap* snap = nullptr);
@@ -73,11 +127,39 @@ public:
 
 protected:
 
+	// Tools preview every frame of a drag. Only worth touching the geometry if we've actually moved since last time
+	bool PreviewMoved()
+	{
+		if (m_moveDelta == m_previewedDelta)
+			return false;
+		m_previewedDelta = m_moveDelta;
+		return true;
+	}
+
 	glm::vec3 m_moveStart;
 	glm::vec3 m_moveDelta;
+
+	// Where the geometry was last previewed at. Nothing's moved when we start
+	glm::vec3 m_previewedDelta = { 0, 0, 0 };
 };
 
 
+// The last hover FindFlags ran, and what it found
+// Good until the mouse leaves its cell, the working axis or flags change, or the world gets edited
+struct hoverCache_t
+{
+	bool valid = false;
+
+	glm::ivec3 mouseCell;
+	glm::vec3 workingAxis;
+	int findFlags;
+	uint32_t editEpoch;
+
+	bool found;
+	selectionInfo_t info;
+	glm::vec3 pointOfIntersect;
+};
+
 class CActionManager
 {
 public:
@@ -85,6 +167,15 @@ public:
 	void CommitAction(IAction* action);
 	bool FindFlags(glm::vec3 mousePos, selectionInfo_t& info, int findFlags, glm::vec3* outPointOfIntersect = nullptr);
 
+	// Adds everything whose center lands in region, looking down the working axis, to selection
+	// Two points make a box from corner to corner. Any more and they're the outline of a lasso
+	// Returns how many new things were added
+	int FindInRegion(const std::vector<glm::vec3>& region, CSelectionSet& selection, int findFlags);
+
+	// The vert closest to pos, looking down the working axis, if there's one within maxDistance. Verts of ignore don't count
+	// Used to snap drags onto the rest of the world
+	bool FindNearestVert(glm::vec3 pos, float maxDistance, CNodeRef ignore, glm::vec3& outVert);
+
 	void Clear();
 
 	void Undo();
@@ -94,6 +185,14 @@ public:
 
 	std::vector<IAction*> m_actionHistory;
 	std::vector<IAction*> m_redoStack;
+
+	// Whatever's been box or lasso selected
+	CSelectionSet m_selection;
+
+private:
+	bool FindFlagsUncached(glm::vec3 mousePos, selectionInfo_t& info, int findFlags, glm::vec3* outPointOfIntersect);
+
+	hoverCache_t m_hoverCache;
 };
 
 CActionManager& GetActionManager();
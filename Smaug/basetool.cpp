@@ -8,6 +8,8 @@
 
 #include <GLFW/glfw3.h>
 
+// How close the mouse has to get to another node's vert for a drag to snap onto it
+#define DRAG_SNAP_VERT_DISTANCE 1.0f
 
 void CBaseDragTool::Enable()
 {
@@ -37,19 +39,20 @@ void CBaseDragTool::Update(float dt, glm::vec3 mousePosSnapped, glm::vec3 mouseP
 		*/
 		
 		delta *= GetCursor().GetWorkingAxisMask();
+		glm::vec3 fn;
 		if (!Input().IsDown({ GLFW_KEY_LEFT_ALT, false }) && m_selectionInfo.side.IsValid())
-		{
-			glm::vec3 fn = glm::normalize(m_selectionInfo.side->normal);
-			delta = fn * glm::dot(delta, fn);
-		}
+			fn = glm::normalize(m_selectionInfo.side->normal);
 		else
-		{
-			glm::vec3 fn = glm::normalize(glm::cross(m_selectionInfo.side->normal, GetCursor().GetWorkingAxis()));
-			delta = fn * glm::dot(delta, fn);
-		}
+			fn = glm::normalize(glm::cross(m_selectionInfo.side->normal, GetCursor().GetWorkingAxis()));
+		delta = fn * glm::dot(delta, fn);
 
 		delta = Grid().Snap(delta);
 
+		// Line up with any other node's vert we're close to, even if it's off the grid
+		glm::vec3 snapVert;
+		if (GetActionManager().FindNearestVert(mousePosRaw, DRAG_SNAP_VERT_DISTANCE, m_selectionInfo.node, snapVert))
+			delta = fn * glm::dot(snapVert * GetCursor().GetWorkingAxisMask() - m_mouseStartDragPos, fn);
+
 		mousePosSnapped = delta + m_mouseStartDragPos;
 
 		GetCursor().SetEditPosition(mousePosSnapped);
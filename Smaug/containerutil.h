@@ -1,6 +1,7 @@
 #pragma once
 #include <assert.h>
 #include <cstddef>
+#include <vector>
 
 // File contents
 // 
@@ -45,6 +46,20 @@
 //	 C2DPXSkipArray<vec3, int> skiparray2dp(arr, arr[1][0].y, 1);
 //	 for (int i = 0; i < 4; i++)
 //		 printf("%d, ", skiparray2dp[i]); // Prints "13, 16, 19, 22,"
+//
+//
+// CSlotMap
+//   Holds pointers in slots that get reused once they're freed up
+//   Every slot has a generation, so asking for something that's since been removed comes back empty, even once its slot is reused
+//   Lookups are just an index, and iterating runs over a packed array of only what's in there
+//   Does not own what it holds!
+//
+//   CSlotMap<Thing, uint16_t> map;
+//   size_t slot = map.insert(thing);
+//   uint16_t generation = map.generation(slot);
+//   map.get(slot, generation); // thing
+//   map.remove(slot);
+//   map.get(slot, generation); // nullptr, no matter what ends up in the slot next
 
 
 
@@ -288,3 +303,138 @@ public:
 	C2DPYSkipArray(S** data, T* firstElement, unsigned int index) : C2DPYSkipArray<void, T>((void**)data, sizeof(S), reinterpret_cast<char*>(firstElement) - reinterpret_cast<char*>(data[index]), index) { }
 	C2DPYSkipArray(S** data, T& firstElement, unsigned int index) : C2DPYSkipArray<void, T>((void**)data, sizeof(S), reinterpret_cast<char*>(&firstElement) - reinterpret_cast<char*>(data[index]), index) { }
 };
+
+
+// Holds pointers in slots that get reused once they're freed up, with a generation per slot to catch stale lookups
+template<typename T, typename G>
+class CSlotMap
+{
+public:
+	typedef typename std::vector<T*>::iterator Iterator;
+
+	// Puts item in a free slot and returns which one
+	size_t insert(T* item)
+	{
+		// insertAt can take slots that are still sitting in the free list. Skip past them
+		while (m_free.size() && m_slots[m_free.back()].item)
+			m_free.pop_back();
+
+		size_t slot;
+		if (m_free.size())
+		{
+			slot = m_free.back();
+			m_free.pop_back();
+		}
+		else
+		{
+			slot = m_slots.size();
+			m_slots.emplace_back();
+		}
+
+		fill(slot, m_slots[slot].nextGeneration++, item);
+		return slot;
+	}
+
+	// Puts item in a specific slot with a specific generation, like when bringing something back on redo
+	// Returns false if the slot's already taken
+	bool insertAt(size_t slot, G generation, T* item)
+	{
+		while (m_slots.size() <= slot)
+		{
+			m_free.push_back(m_slots.size());
+			m_slots.emplace_back();
+		}
+
+		slot_t& s = m_slots[slot];
+		if (s.item)
+			return false;
+
+		// Whatever goes in here next can't be mistaken for this
+		if (s.nextGeneration <= generation)
+			s.nextGeneration = generation + 1;
+
+		fill(slot, generation, item);
+		return true;
+	}
+
+	void remove(size_t slot)
+	{
+		if (slot >= m_slots.size() || !m_slots[slot].item)
+			return;
+
+		// Move the last item into our spot to keep everything packed
+		size_t dense = m_slots[slot].dense;
+		m_dense[dense] = m_dense.back();
+		m_denseSlots[dense] = m_denseSlots.back();
+		m_slots[m_denseSlots[dense]].dense = dense;
+		m_dense.pop_back();
+		m_denseSlots.pop_back();
+
+		m_slots[slot].item = nullptr;
+		m_free.push_back(slot);
+	}
+
+	// Empties every slot but keeps their generations going, so anything still holding an old slot and generation stays stale
+	// insertAt can still put back whatever generation it's told to, so anything loading over old refs should drop them too
+	void clear()
+	{
+		m_free.clear();
+		for (size_t i = m_slots.size(); i-- > 0;)
+		{
+			// nextGeneration's always past the generation in the slot, so whatever comes next can't be mistaken for it
+			m_slots[i].item = nullptr;
+
+			// Backwards, so the lowest slots get handed out first
+			m_free.push_back(i);
+		}
+		m_dense.clear();
+		m_denseSlots.clear();
+	}
+
+	// nullptr if the slot's empty or has moved on to another generation
+	T* get(size_t slot, G generation) const
+	{
+		if (slot >= m_slots.size() || m_slots[slot].generation != generation)
+			return nullptr;
+		return m_slots[slot].item;
+	}
+
+	// Whatever's in the slot right now
+	T* get(size_t slot) const { return slot < m_slots.size() ? m_slots[slot].item : nullptr; }
+	G generation(size_t slot) const { return slot < m_slots.size() ? m_slots[slot].generation : 0; }
+	bool contains(size_t slot) const { return get(slot) != nullptr; }
+
+	inline size_t count() const { return m_dense.size(); }
+	inline size_t slotCount() const { return m_slots.size(); }
+
+	// Packed. Order changes as things get removed
+	Iterator begin() { return m_dense.begin(); }
+	Iterator end() { return m_dense.end(); }
+
+private:
+	void fill(size_t slot, G generation, T* item)
+	{
+		slot_t& s = m_slots[slot];
+		s.item = item;
+		s.generation = generation;
+		s.dense = m_dense.size();
+		m_dense.push_back(item);
+		m_denseSlots.push_back(slot);
+	}
+
+	struct slot_t
+	{
+		T* item = nullptr;
+		G generation = 0;
+		G nextGeneration = 0;
+
+		// Where item sits in m_dense
+		size_t dense = 0;
+	};
+
+	std::vector<slot_t> m_slots;
+	std::vector<size_t> m_free;
+
+	std::vector<T*> m_dense;
+	std::vector<size_t> m_denseSlots;
+};
@@ -71,8 +71,17 @@ void CDebugDraw::HEFace(face_t* face, glm::vec3 color, float width, float decay)
 
 void CDebugDraw::HEPart(meshPart_t* part, glm::vec3 color, float width, float decay)
 {
-    for (auto f : part->tris)
-        HEFace(f, color, width, decay);
+    glm::vec3 offset = part->mesh->origin;
+
+    for (size_t i = 0; i + 2 < part->tris.size(); i += 3)
+    {
+        glm::vec3 a = *partTriVert(part, part->tris[i]) + offset;
+        glm::vec3 b = *partTriVert(part, part->tris[i + 1]) + offset;
+        glm::vec3 c = *partTriVert(part, part->tris[i + 2]) + offset;
+        Line(a, b, color, width, decay);
+        Line(b, c, color, width, decay);
+        Line(c, a, color, width, decay);
+    }
 }
 
 
@@ -1,5 +1,6 @@
 #include "editoractions.h"
 #include "debugdraw.h"
+#include "log.h"
 #include <utils.h>
 
 CNode* CWallExtrudeAction::CreateExtrusion()
@@ -35,7 +36,6 @@ void CWallExtrudeAction::Act()
 	CNode* node = CreateExtrusion();
 	GetWorldEditor().RegisterNode(node);
 	m_quad = node;
-	node->ConnectTo(m_node);
 	node->Update();
 }
 
@@ -44,8 +44,7 @@ void CWallExtrudeAction::Undo()
 	if (m_quad.IsValid())
 	{
 		GetWorldEditor().DeleteNode(m_quad.Node());
-		m_node->DisconnectFrom(m_quad);
-		m_node->UpdateThisOnly();
+		m_node->Update();
 	}
 
 }
@@ -55,8 +54,13 @@ void CWallExtrudeAction::Redo()
 	SASSERT(!m_quad.Node());
 
 	CNode* node = CreateExtrusion();
-	GetWorldEditor().AssignID(node, m_quad.ID());
-	node->ConnectTo(m_node);
+	if (!GetWorldEditor().AssignID(node, m_quad.ID(), m_quad.Generation()))
+	{
+		// Something else has our old id. Anything still pointing at the old extrusion goes stale, but at least the extrusion comes back
+		Log::Warn("[Wall Extrude] Couldn't get id %u back on redo. Giving the extrusion a new one\n", m_quad.ID());
+		GetWorldEditor().RegisterNode(node);
+		m_quad = node;
+	}
 	node->Update();
 
 }
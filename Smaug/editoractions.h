@@ -15,6 +15,9 @@ public:
 
 	virtual void Preview()
 	{
+		if (!PreviewMoved())
+			return;
+
 		*m_selectInfo.vertex->vert = m_originalPos + m_moveDelta;
 		m_node->PreviewUpdate();
 	}
@@ -100,6 +103,9 @@ public:
 
 	virtual void Preview()
 	{
+		if (!PreviewMoved())
+			return;
+
 		for (int i = 0; auto v : m_selectInfo.side->verts)
 			*v->vert = m_originalPos[i++] + m_moveDelta;
 
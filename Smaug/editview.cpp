@@ -139,14 +139,28 @@ void CEditView::Draw(float dt)
 
 	
 
-	GetWorldRenderer().Draw2D(m_viewId, Shader::WORLD_PREVIEW_SHADER);
+	// We're ortho, so everything we can see is in a box around the camera, as deep as the clip planes
+	// Boxes out of the view's rotated rectangle, so it'll grab a little extra when we're at an angle
+	float reach = max(width, height);
+	aabb_t viewBox = { m_cameraPos, m_cameraPos };
+	for (glm::vec3 extent : { right * reach, forward * reach, up * 900.0f })
+	{
+		viewBox.min -= glm::abs(extent);
+		viewBox.max += glm::abs(extent);
+	}
+
+	std::vector<CNode*> visible;
+	GetWorldEditor().m_bvh.FindInBox(viewBox, { 1, 1, 1 }, [&](CNode* node) { visible.push_back(node); });
+	GetWorldEditor().Materialise(visible);
+
+	GetWorldRenderer().Draw2D(m_viewId, Shader::WORLD_PREVIEW_SHADER, visible);
 	
 	float t = glfwGetTime();
 
-	for (auto p : GetWorldEditor().m_nodes)
+	for (auto node : visible)
 	{
 		CModelTransform mt;
-		mt.SetAbsOrigin(p.second->Origin());
+		mt.SetAbsOrigin(node->Origin());
 		mt.SetAbsScale(min(m_viewZoom / 16.0f, 4.0f));
 		m_tickModel->Render(&mt);
 	}
@@ -0,0 +1,322 @@
+#include "facebvh.h"
+
+#include <algorithm>
+#include <bit>
+
+// Faces per leaf. The ray gets tested against all of their boxes at once, so fill up a whole batch
+#define FACEBVH_LEAF_SIZE AABB_BATCH_SIZE
+// Past this depth, builds split down the middle instead of by SAH so we stay within FACEBVH_STACK_SIZE
+#define FACEBVH_SAH_DEPTH 28
+#define FACEBVH_BIN_COUNT 12
+
+void CFaceBVH::Clear()
+{
+	m_tree.clear();
+	m_faces.clear();
+	m_batches.clear();
+}
+
+void CFaceBVH::Build(mesh_t& mesh)
+{
+	Clear();
+
+	std::vector<faceBuildItem_t> items;
+	for (auto pa : mesh.parts)
+	{
+		for (auto f : pa->collision)
+		{
+			// Nothing to hit
+			if (f->verts.size() < 3)
+				continue;
+
+			aabb_t aabb = { *f->verts.front()->vert, *f->verts.front()->vert };
+			for (auto v : f->verts)
+				aabb = aabbUnion(aabb, { *v->vert, *v->vert });
+
+			items.push_back({ { f, pa }, aabb, (aabb.min + aabb.max) * 0.5f });
+		}
+	}
+
+	if (items.size() == 0)
+		return;
+
+	m_faces.reserve(items.size());
+	m_tree.reserve(items.size() * 2);
+	m_tree.emplace_back();
+	BuildRange(0, items, 0, items.size(), 0);
+}
+
+// Binned SAH, same as CWorldBVH's, but stopping once there's few enough faces to go in a leaf
+void CFaceBVH::BuildRange(int index, std::vector<faceBuildItem_t>& items, int start, int end, int depth)
+{
+	aabb_t bounds = items[start].aabb;
+	aabb_t centers = { items[start].center, items[start].center };
+	for (int i = start + 1; i < end; i++)
+	{
+		bounds = aabbUnion(bounds, items[i].aabb);
+		centers = aabbUnion(centers, { items[i].center, items[i].center });
+	}
+	m_tree[index].aabb = bounds;
+
+	if (end - start <= FACEBVH_LEAF_SIZE)
+	{
+		m_tree[index].start = m_faces.size();
+		m_tree[index].count = end - start;
+		m_tree[index].batch = m_batches.size();
+
+		aabbBatch_t& batch = m_batches.emplace_back();
+		for (int i = start; i < end; i++)
+		{
+			aabbBatchSet(batch, i - start, items[i].aabb);
+			m_faces.push_back(items[i].item);
+		}
+		return;
+	}
+
+	glm::vec3 extents = centers.max - centers.min;
+	int axis = 0;
+	if (extents.y > extents[axis])
+		axis = 1;
+	if (extents.z > extents[axis])
+		axis = 2;
+
+	float extent = extents[axis];
+	float low = centers.min[axis];
+	auto binOf = [&](const faceBuildItem_t& item)
+	{
+		int bin = (item.center[axis] - low) / extent * FACEBVH_BIN_COUNT;
+		return std::min(bin, FACEBVH_BIN_COUNT - 1);
+	};
+
+	int mid = start;
+	if (extent > 0 && depth < FACEBVH_SAH_DEPTH)
+	{
+		aabb_t binBox[FACEBVH_BIN_COUNT];
+		int binCount[FACEBVH_BIN_COUNT] = {};
+		for (int i = start; i < end; i++)
+		{
+			int bin = binOf(items[i]);
+			binBox[bin] = binCount[bin] ? aabbUnion(binBox[bin], items[i].aabb) : items[i].aabb;
+			binCount[bin]++;
+		}
+
+		// Sweep in from the right to get the cost of everything past each split
+		float rightCost[FACEBVH_BIN_COUNT] = {};
+		aabb_t box;
+		int count = 0;
+		for (int b = FACEBVH_BIN_COUNT - 1; b > 0; b--)
+		{
+			if (binCount[b])
+			{
+				box = count ? aabbUnion(box, binBox[b]) : binBox[b];
+				count += binCount[b];
+			}
+			rightCost[b] = count ? aabbArea(box) * count : 0;
+		}
+
+		// And then from the left to find the cheapest split
+		int bestSplit = -1;
+		float bestCost = FLT_MAX;
+		count = 0;
+		for (int b = 0; b < FACEBVH_BIN_COUNT - 1; b++)
+		{
+			if (binCount[b])
+			{
+				box = count ? aabbUnion(box, binBox[b]) : binBox[b];
+				count += binCount[b];
+			}
+
+			if (count == 0 || count == end - start)
+				continue;
+
+			float cost = aabbArea(box) * count + rightCost[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = b;
+			}
+		}
+
+		if (bestSplit != -1)
+			mid = std::partition(items.begin() + start, items.begin() + end, [&](const faceBuildItem_t& item) { return binOf(item) <= bestSplit; }) - items.begin();
+	}
+
+	// Everything's stacked up on top of eachother, or we're getting too deep. Just split it in half
+	if (mid == start || mid == end)
+	{
+		mid = (start + end) / 2;
+		std::nth_element(items.begin() + start, items.begin() + mid, items.begin() + end, [&](const faceBuildItem_t& a, const faceBuildItem_t& b) { return a.center[axis] < b.center[axis]; });
+	}
+
+	// Children sit side by side
+	int children = m_tree.size();
+	m_tree.emplace_back();
+	m_tree.emplace_back();
+	m_tree[index].start = children;
+	m_tree[index].count = 0;
+
+	BuildRange(children, items, start, mid, depth + 1);
+	BuildRange(children + 1, items, mid, end, depth + 1);
+}
+
+void CFaceBVH::TraceRay(ray_t ray, testRayPlane_t& closest, void (*test)(ray_t ray, face_t* face, testRayPlane_t& closest))
+{
+	if (m_tree.size() == 0)
+		return;
+
+	glm::vec3 invDir = 1.0f / ray.dir;
+
+	// The nearer child is always on top, with the further one waiting under it
+	struct
+	{
+		int index;
+		float enter;
+	} stack[FACEBVH_STACK_SIZE];
+	int top = 0;
+
+	float enter;
+	if (!rayAABBSlab(m_tree[0].aabb, ray.origin, invDir, closest.t, enter))
+		return;
+	stack[top++] = { 0, enter };
+
+	while (top)
+	{
+		int index = stack[--top].index;
+
+		// Something closer turned up since this was pushed
+		if (stack[top].enter > closest.t)
+			continue;
+
+		faceNode_t& n = m_tree[index];
+		if (n.count)
+		{
+			// Only bother with the faces whose boxes we actually go through
+			float faceEnter[AABB_BATCH_SIZE];
+			int hits = rayAABBBatchTest(m_batches[n.batch], ray.origin, invDir, closest.t, faceEnter);
+			for (int i = 0; i < n.count; i++)
+				if ((hits & (1 << i)) && faceEnter[i] <= closest.t)
+					test(ray, m_faces[n.start + i].face, closest);
+			continue;
+		}
+
+		float enter0, enter1;
+		bool hit0 = rayAABBSlab(m_tree[n.start].aabb, ray.origin, invDir, closest.t, enter0);
+		bool hit1 = rayAABBSlab(m_tree[n.start + 1].aabb, ray.origin, invDir, closest.t, enter1);
+
+		if (hit0 && hit1)
+		{
+			if (enter0 <= enter1)
+			{
+				stack[top++] = { n.start + 1, enter1 };
+				stack[top++] = { n.start, enter0 };
+			}
+			else
+			{
+				stack[top++] = { n.start, enter0 };
+				stack[top++] = { n.start + 1, enter1 };
+			}
+		}
+		else if (hit0)
+			stack[top++] = { n.start, enter0 };
+		else if (hit1)
+			stack[top++] = { n.start + 1, enter1 };
+	}
+}
+
+void CFaceBVH::TracePacket(const rayPacket_t& packet, int active, testRayPlane_t* closest, void (*test)(const rayPacket_t& packet, int active, face_t* face, testRayPlane_t* closest))
+{
+	if (m_tree.size() == 0 || !active)
+		return;
+
+	// Only test can change closest, so maxT is gathered back up after every call to it
+	float maxT[RAY_PACKET_SIZE];
+	float enter[RAY_PACKET_SIZE];
+	auto gatherT = [&]()
+	{
+		for (int r = 0; r < packet.count; r++)
+			maxT[r] = closest[r].t;
+	};
+
+	// Nearest of the rays that hit, or FLT_MAX if none did
+	auto nearest = [&](int hits)
+	{
+		float n = FLT_MAX;
+		for (unsigned int b = hits; b; b &= b - 1)
+			n = std::min(n, enter[std::countr_zero(b)]);
+		return n;
+	};
+
+	// Same as TraceRay, but every entry carries the rays that made it this far
+	struct
+	{
+		int index;
+		int rays;
+		float enter;
+	} stack[FACEBVH_STACK_SIZE];
+	int top = 0;
+
+	gatherT();
+	int hits = rayPacketAABBTest(packet, active, m_tree[0].aabb, maxT, enter);
+	if (!hits)
+		return;
+	stack[top++] = { 0, hits, nearest(hits) };
+
+	while (top)
+	{
+		top--;
+		int index = stack[top].index;
+		int rays = stack[top].rays;
+
+		// Drop the rays that found something closer since this was pushed
+		int still = 0;
+		for (unsigned int b = rays; b; b &= b - 1)
+		{
+			int r = std::countr_zero(b);
+			if (stack[top].enter <= maxT[r])
+				still |= 1 << r;
+		}
+		if (!still)
+			continue;
+
+		faceNode_t& n = m_tree[index];
+		if (n.count)
+		{
+			// Cull the rays down to just the ones going through each face's box
+			aabbBatch_t& batch = m_batches[n.batch];
+			for (int i = 0; i < n.count; i++)
+			{
+				aabb_t box = { { batch.min[0][i], batch.min[1][i], batch.min[2][i] }, { batch.max[0][i], batch.max[1][i], batch.max[2][i] } };
+				int faceHits = rayPacketAABBTest(packet, still, box, maxT, enter);
+				if (faceHits)
+				{
+					test(packet, faceHits, m_faces[n.start + i].face, closest);
+					gatherT();
+				}
+			}
+			continue;
+		}
+
+		int hits0 = rayPacketAABBTest(packet, still, m_tree[n.start].aabb, maxT, enter);
+		float enter0 = nearest(hits0);
+		int hits1 = rayPacketAABBTest(packet, still, m_tree[n.start + 1].aabb, maxT, enter);
+		float enter1 = nearest(hits1);
+
+		if (hits0 && hits1)
+		{
+			if (enter0 <= enter1)
+			{
+				stack[top++] = { n.start + 1, hits1, enter1 };
+				stack[top++] = { n.start, hits0, enter0 };
+			}
+			else
+			{
+				stack[top++] = { n.start, hits0, enter0 };
+				stack[top++] = { n.start + 1, hits1, enter1 };
+			}
+		}
+		else if (hits0)
+			stack[top++] = { n.start, hits0, enter0 };
+		else if (hits1)
+			stack[top++] = { n.start + 1, hits1, enter1 };
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "raytest.h"
+
+#include <vector>
+
+// Bounding volume hierarchy over the collision faces of a single mesh, local to its origin
+// Collision gets thrown out and remade whenever the shape changes, so there's no refitting. It's just built again
+class CFaceBVH
+{
+public:
+	void Clear();
+
+	// Throws out the tree and builds a fresh one over every part's collision
+	void Build(mesh_t& mesh);
+
+	// Runs test on every face whose box the ray passes through, nearest first
+	// Faces that start further along the ray than closest.t are skipped, so test should only ever shrink closest.t
+	void TraceRay(ray_t ray, testRayPlane_t& closest, void (*test)(ray_t ray, face_t* face, testRayPlane_t& closest));
+
+	// TraceRay for every ray in active at once. Faces are only handed to test with the rays that actually pass through their box
+	void TracePacket(const rayPacket_t& packet, int active, testRayPlane_t* closest, void (*test)(const rayPacket_t& packet, int active, face_t* face, testRayPlane_t* closest));
+
+	// Runs test on every face whose box, grown by bloat, holds the point. Stops as soon as test returns true
+	template<typename T>
+	bool FindAtPoint(glm::vec3 point, float bloat, T test);
+
+	size_t FaceCount() { return m_faces.size(); }
+
+private:
+	struct faceNode_t
+	{
+		aabb_t aabb;
+
+		// Leaves own faces [start, start + count). Branches have a count of 0, and their children sit at start and start + 1
+		int start = 0;
+		int count = 0;
+
+		// Leaves only. Where the boxes of our faces are in m_batches
+		int batch = -1;
+	};
+
+	struct faceItem_t
+	{
+		face_t* face;
+		meshPart_t* part;
+	};
+
+	struct faceBuildItem_t
+	{
+		faceItem_t item;
+		aabb_t aabb;
+		glm::vec3 center;
+	};
+
+	void BuildRange(int index, std::vector<faceBuildItem_t>& items, int start, int end, int depth);
+
+	std::vector<faceNode_t> m_tree;
+	std::vector<faceItem_t> m_faces;
+
+	// Every leaf's face boxes, so they can all be tested in one go
+	std::vector<aabbBatch_t> m_batches;
+};
+
+// Deep enough for anything BuildRange can make
+#define FACEBVH_STACK_SIZE 64
+
+template<typename T>
+bool CFaceBVH::FindAtPoint(glm::vec3 point, float bloat, T test)
+{
+	if (m_tree.size() == 0)
+		return false;
+
+	int stack[FACEBVH_STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top)
+	{
+		faceNode_t& n = m_tree[stack[--top]];
+		if (!testPointInAABB(point, n.aabb, bloat))
+			continue;
+
+		if (n.count == 0)
+		{
+			stack[top++] = n.start + 1;
+			stack[top++] = n.start;
+			continue;
+		}
+
+		for (int i = n.start; i < n.start + n.count; i++)
+			if (test(m_faces[i].face, m_faces[i].part))
+				return true;
+	}
+
+	return false;
+}
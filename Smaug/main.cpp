@@ -1,4 +1,5 @@
 #include "smaugapp.h"
+#include "meshbench.h"
 #include "utils.h"
 
 #ifdef _WIN32
@@ -10,6 +11,10 @@ static constexpr auto DEFAULT_RENDER_TYPE = bgfx::RendererType::OpenGL;
 int main( int argc, char** argv )
 {
 	CommandLine::Set(argc, argv);
+
+	// Benchmarks don't need a window
+	if (CommandLine::HasParam("-meshbench"))
+		return runMeshBenchmarks(CommandLine::GetParam("-meshbench"));
 	
 	auto renderType = DEFAULT_RENDER_TYPE;
 	if(CommandLine::HasAny("-gl", "-gles"))
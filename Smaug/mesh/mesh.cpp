@@ -3,6 +3,8 @@
 #include "containerutil.h"
 #include "utils.h"
 #include <glm/geometric.hpp>
+#include <glm/common.hpp>
+#include <unordered_map>
 
 // Gets the normal of the *next* vert
 glm::vec3 vertNextNormal(vertex_t* vert)
@@ -52,6 +54,8 @@ void faceFromLoop(halfEdge_t* startEdge, face_t* faceToFill)
 {
 	halfEdge_t* he = startEdge;
 	do {
+		he->id = faceToFill->edges.size();
+		he->vert->id = faceToFill->verts.size();
 		faceToFill->edges.push_back(he);
 		faceToFill->verts.push_back(he->vert);
 		
@@ -80,11 +84,11 @@ glm::vec3** addMeshVerts(mesh_t& mesh, glm::vec3* points, int pointCount)
 }
 
 // Creates and defines a new face within a mesh
-void defineFace(face_t* face, CUArrayAccessor<glm::vec3*> vecs, int vecCount);
 void addMeshFace(mesh_t& mesh, glm::vec3** points, int pointCount)
 {
 	meshPart_t* mp = new meshPart_t;
 	mp->mesh = &mesh;
+	mp->id = mesh.parts.size();
 	mesh.parts.push_back(mp);
 
 	defineFace(mp, points, pointCount);
@@ -125,6 +129,7 @@ void defineFace(face_t* face, CUArrayAccessor<glm::vec3*> vecs, int vecCount)
 
 		lastHe = he;
 		lastVert = v;
+		he->id = v->id = i;
 		face->edges.push_back(he);
 		face->verts.push_back(v);
 	}
@@ -145,8 +150,6 @@ void defineMeshPartFaces(meshPart_t& mesh)
 		delete mesh.sliced;
 		mesh.sliced = nullptr;
 	}
-	for (auto f : mesh.tris)
-		delete f;
 	for (auto f : mesh.collision)
 		delete f;
 	mesh.collision.clear();
@@ -168,7 +171,22 @@ void defineMeshPartFaces(meshPart_t& mesh)
 
 	// Compute our normal
 	mesh.normal = glm::normalize(faceNormal(&mesh));
-
+	mesh.planeDist = glm::dot(mesh.normal, *mesh.verts.front()->vert);
+
+	// Flatten out onto whichever axes the normal leans the least on
+	glm::vec3 absNormal = glm::abs(mesh.normal);
+	int drop = 0;
+	if (absNormal.y > absNormal[drop])
+		drop = 1;
+	if (absNormal.z > absNormal[drop])
+		drop = 2;
+	mesh.outlineAxes[0] = (drop + 1) % 3;
+	mesh.outlineAxes[1] = (drop + 2) % 3;
+
+	mesh.outline.clear();
+	mesh.outline.reserve(mesh.verts.size());
+	for (auto v : mesh.verts)
+		mesh.outline.push_back({ (*v->vert)[mesh.outlineAxes[0]], (*v->vert)[mesh.outlineAxes[1]] });
 }
 // Terrible
 glm::vec3*& vertVectorAccessor(void* vec, size_t i)
@@ -205,6 +223,7 @@ void cloneFaceInto(face_t* in, face_t* cloneOut)
 			lastCloneEdge->vert = cv;
 		}
 
+		ch->id = cv->id = cloneOut->verts.size();
 		cloneOut->verts.push_back(cv);
 		cloneOut->edges.push_back(ch);
 
@@ -299,6 +318,78 @@ void recenterMesh(mesh_t& mesh)
 	}
 }
 
+void packMesh(mesh_t& mesh, packedMesh_t& packed)
+{
+	packed.verts.clear();
+	packed.indices.clear();
+	packed.partSizes.clear();
+
+	std::unordered_map<glm::vec3*, uint32_t> index;
+	index.reserve(mesh.verts.size());
+	packed.verts.reserve(mesh.verts.size());
+	for (auto v : mesh.verts)
+	{
+		index[v] = packed.verts.size();
+		packed.verts.push_back(*v);
+	}
+
+	packed.partSizes.reserve(mesh.parts.size());
+	for (auto p : mesh.parts)
+	{
+		packed.partSizes.push_back(p->verts.size());
+		for (auto v : p->verts)
+			packed.indices.push_back(index[v->vert]);
+	}
+}
+
+void unpackMesh(packedMesh_t& packed, mesh_t& mesh)
+{
+	size_t start = mesh.verts.size();
+	mesh.verts.reserve(start + packed.verts.size());
+	for (auto& v : packed.verts)
+		mesh.verts.push_back(new glm::vec3(v));
+
+	mesh.parts.reserve(mesh.parts.size() + packed.partSizes.size());
+	std::vector<glm::vec3*> faceVerts;
+	size_t next = 0;
+	for (auto size : packed.partSizes)
+	{
+		faceVerts.clear();
+		for (uint32_t i = 0; i < size; i++)
+			faceVerts.push_back(mesh.verts[start + packed.indices[next++]]);
+		addMeshFace(mesh, faceVerts.data(), faceVerts.size());
+	}
+
+	std::vector<glm::vec3>().swap(packed.verts);
+	std::vector<uint32_t>().swap(packed.indices);
+	std::vector<uint32_t>().swap(packed.partSizes);
+}
+
+aabb_t packedMeshAABB(packedMesh_t& packed)
+{
+	glm::vec3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	glm::vec3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+	for (auto& v : packed.verts)
+	{
+		max = glm::max(max, v);
+		min = glm::min(min, v);
+	}
+
+	return { min,max };
+}
+
+void recenterPackedMesh(packedMesh_t& packed, glm::vec3& origin)
+{
+	glm::vec3 averageOrigin = glm::vec3(0, 0, 0);
+	for (auto& v : packed.verts)
+		averageOrigin += v;
+	averageOrigin /= packed.verts.size();
+
+	origin += averageOrigin;
+	for (auto& v : packed.verts)
+		v -= averageOrigin;
+}
+
 glm::vec3 faceCenter(face_t* face)
 {
 	// Center of face
@@ -325,9 +416,6 @@ meshPart_t::~meshPart_t()
 
 	for (auto f : collision)
 		delete f;
-
-	for (auto f : tris)
-		delete f;
 }
 
 mesh_t::~mesh_t()
@@ -1,7 +1,9 @@
 #pragma once
 #include "utils.h"
+#include "containerutil.h"
 #include <glm/vec3.hpp>
 #include <vector>
+#include <cstdint>
 
 /*
 
@@ -55,6 +57,9 @@ struct vertex_t
 
 	// The edge that stems out of this vert
 	halfEdge_t* edge = nullptr;
+
+	// Where we sit in our face's verts. Set by defineFace, faceFromLoop, and cloneFaceInto
+	uint32_t id = 0;
 };
 
 
@@ -73,6 +78,9 @@ struct halfEdge_t
 	halfEdge_t* next = nullptr;
 
 	EdgeFlags flags = EdgeFlags::EF_NONE;
+
+	// Where we sit in our face's edges. Set by defineFace, faceFromLoop, and cloneFaceInto
+	uint32_t id = 0;
 };
 
 
@@ -133,7 +141,8 @@ struct meshPart_t : public face_t
 	std::vector<face_t*> collision;
 
 	// A triangulated representation of the face. This is what gets rendered.
-	std::vector<face_t*> tris;
+	// Every three indices make a tri. Indices point into verts, and then on into sliced->cutVerts
+	std::vector<uint32_t> tris;
 
 	// Data that gets populated when this mesh gets sliced. When this is not nullptr, it should take priority over our collisions and tris
 	slicedMeshPartData_t* sliced = nullptr;
@@ -141,8 +150,19 @@ struct meshPart_t : public face_t
 	// What mesh do we belong to
 	mesh_t* mesh = nullptr;
 
+	// Where we sit in our mesh's parts. Parts never get removed, so this never changes
+	uint32_t id = 0;
+
 	// Precomputed normal of the part. Generated by defineMeshPartFaces
 	glm::vec3 normal;
+
+	// Precomputed plane of the part, where dot(normal, p) == planeDist. Generated by defineMeshPartFaces
+	float planeDist = 0;
+
+	// Our verts flattened down onto the two axes the normal points along least. Generated by defineMeshPartFaces
+	// Lets point in part tests skip the collision entirely
+	std::vector<glm::vec2> outline;
+	int outlineAxes[2] = { 0, 1 };
 };
 
 struct mesh_t
@@ -180,6 +200,17 @@ struct cuttableMesh_t : public mesh_t
 	std::vector<glm::vec3*> cutVerts;
 };
 
+// Just a mesh's verts and which of them each part goes around. All a paged out node keeps
+// Unpacking builds the same mesh back up, with its verts, parts and ids all in the same order
+struct packedMesh_t
+{
+	std::vector<glm::vec3> verts;
+
+	// Every part's indices into verts, one part after the other
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> partSizes;
+};
+
 
 // Returns start of the points within mesh.verts
 glm::vec3** addMeshVerts(mesh_t& mesh, glm::vec3* points, int pointCount);
@@ -187,11 +218,23 @@ glm::vec3** addMeshVerts(mesh_t& mesh, glm::vec3* points, int pointCount);
 // Does not add points to mesh! Only adds face
 void addMeshFace(mesh_t& mesh, glm::vec3** points, int pointCount);
 
+// Wires up all the HEs for this face
+// Does not triangulate
+void defineFace(face_t* face, CUArrayAccessor<glm::vec3*> vecs, int vecCount);
+
 void defineMeshPartFaces(meshPart_t& mesh);
 
 
 aabb_t meshAABB(mesh_t& mesh);
 void recenterMesh(mesh_t& mesh);
+
+// Copies mesh's verts and parts into packed. Leaves mesh as is
+void packMesh(mesh_t& mesh, packedMesh_t& packed);
+// Builds mesh's verts and parts back up out of packed, then empties it. Parts still need defineMeshPartFaces
+void unpackMesh(packedMesh_t& packed, mesh_t& mesh);
+// Same as their mesh_t versions, down to the order the verts get added up in
+aabb_t packedMeshAABB(packedMesh_t& packed);
+void recenterPackedMesh(packedMesh_t& packed, glm::vec3& origin);
 glm::vec3 faceCenter(face_t* face);
 glm::vec3 faceNormal(face_t* face, glm::vec3* outCenter = nullptr);
 glm::vec3 convexFaceNormal(face_t* face);
@@ -205,6 +248,9 @@ void faceFromLoop(halfEdge_t* startEdge, face_t* faceToFill);
 
 void cloneFaceInto(face_t* in, face_t* cloneOut);
 
+// Vert that one of a part's tri indices points to
+inline glm::vec3* partTriVert(meshPart_t* part, uint32_t index) { return index < part->verts.size() ? part->verts[index]->vert : part->sliced->cutVerts[index - part->verts.size()]; }
+
 inline meshPart_t* parentPart(face_t* f) { if (!f) return 0; if (f->flags & FaceFlags::FF_MESH_PART) return static_cast<meshPart_t*>(f); if (f->parent) return parentPart(f->parent); return 0; }
 inline mesh_t* parentMesh(face_t* f) { if (!f) return 0; meshPart_t* part = parentPart(f); if (part) return part->mesh; return 0; }
 
@@ -1,4 +1,5 @@
 #include "meshtest.h"
+#include "simd.h"
 #include <glm/geometric.hpp>
 
 bool pointInConvexMeshPart(meshPart_t* part, glm::vec3 pos)
@@ -58,6 +59,23 @@ bool pointInConvexLoop(vertex_t* vert, glm::vec3 pos)
 bool pointInConvexLoop(vertex_t* vert, glm::vec3 pos) { return pointInConvexLoop<true>(vert, pos); }
 bool pointInConvexLoopNoEdges(vertex_t* vert, glm::vec3 pos) { return pointInConvexLoop<false>(vert, pos); }
 
+bool pointInPartOutline(meshPart_t* part, glm::vec3 pos)
+{
+	std::vector<glm::vec2>& outline = part->outline;
+	glm::vec2 p = { pos[part->outlineAxes[0]], pos[part->outlineAxes[1]] };
+
+	// Count how many edges we cross heading off to the right
+	bool inside = false;
+	for (size_t i = 0, j = outline.size() - 1; i < outline.size(); j = i++)
+	{
+		glm::vec2 a = outline[i];
+		glm::vec2 b = outline[j];
+		if ((a.y > p.y) != (b.y > p.y) && p.x < a.x + (p.y - a.y) / (b.y - a.y) * (b.x - a.x))
+			inside = !inside;
+	}
+	return inside;
+}
+
 template<bool ignoreNonOuterEdges>
 pointInConvexTest_t pointInConvexLoopQuery(vertex_t* vert, glm::vec3 pos)
 {
@@ -109,3 +127,112 @@ pointInConvexTest_t pointInConvexLoopQueryIgnoreNonOuterEdges(vertex_t* vert, gl
 	return pointInConvexLoopQuery<true>(vert, pos);
 }
 
+
+void convexLoopPlanes(vertex_t* vert, convexLoopPlanes_t& planes, bool ignoreNonOuterEdges)
+{
+	planes.startX.clear();
+	planes.startY.clear();
+	planes.startZ.clear();
+	planes.perpX.clear();
+	planes.perpY.clear();
+	planes.perpZ.clear();
+	planes.countsOnEdge.clear();
+
+	// Same normal and perps as pointInConvexLoopQuery, so the two always agree
+	glm::vec3 norm = vertNextNormal(vert);
+
+	vertex_t* v = vert;
+	do
+	{
+		vertex_t* next = v->edge->vert;
+
+		glm::vec3 delta = *next->vert - *v->vert;
+		glm::vec3 perp = glm::cross(delta, norm);
+
+		planes.startX.push_back(v->vert->x);
+		planes.startY.push_back(v->vert->y);
+		planes.startZ.push_back(v->vert->z);
+		planes.perpX.push_back(perp.x);
+		planes.perpY.push_back(perp.y);
+		planes.perpZ.push_back(perp.z);
+		planes.countsOnEdge.push_back(!ignoreNonOuterEdges || !v->edge->pair);
+
+		v = next;
+	} while (v != vert);
+}
+
+void convexPointsClear(convexPoints_t& points)
+{
+	points.x.clear();
+	points.y.clear();
+	points.z.clear();
+	points.count = 0;
+}
+
+void convexPointsAdd(convexPoints_t& points, glm::vec3 pos)
+{
+	// Grow a whole SIMD width at a time, so there's always a full one to load
+	if (points.count == points.x.size())
+	{
+		size_t size = points.x.size() + SIMD_LANES;
+		points.x.resize(size);
+		points.y.resize(size);
+		points.z.resize(size);
+	}
+
+	points.x[points.count] = pos.x;
+	points.y[points.count] = pos.y;
+	points.z[points.count] = pos.z;
+	points.count++;
+}
+
+pointInConvexTest_t pointsInConvexLoopQuery(const convexLoopPlanes_t& planes, const convexPoints_t& points, uint8_t* flags)
+{
+	pointInConvexTest_t test;
+	lanes_t zero = lanesSet(0.0f);
+
+	for (size_t p = 0; p < points.count; p += SIMD_LANES)
+	{
+		lanes_t x = lanesLoad(&points.x[p]), y = lanesLoad(&points.y[p]), z = lanesLoad(&points.z[p]);
+		lanes_t outside = lanesLess(zero, zero);
+		lanes_t onEdge = outside;
+
+		for (size_t e = 0; e < planes.perpX.size(); e++)
+		{
+			// Same math as the single point version, in the same order, so edge cases come out the same
+			lanes_t m = lanesAdd(lanesAdd(
+				lanesMul(lanesSub(x, lanesSet(planes.startX[e])), lanesSet(planes.perpX[e])),
+				lanesMul(lanesSub(y, lanesSet(planes.startY[e])), lanesSet(planes.perpY[e]))),
+				lanesMul(lanesSub(z, lanesSet(planes.startZ[e])), lanesSet(planes.perpZ[e])));
+
+			outside = lanesOr(outside, lanesLess(zero, m));
+
+			// Neither in front of or behind it. NANs land here too, same as they do in the single point version
+			if (planes.countsOnEdge[e])
+				onEdge = lanesOr(onEdge, lanesNot(lanesOr(lanesLess(zero, m), lanesLess(m, zero))));
+		}
+
+		int outBits = lanesBits(outside);
+		int onBits = lanesBits(onEdge);
+		size_t end = std::min(points.count - p, (size_t)SIMD_LANES);
+		for (size_t l = 0; l < end; l++)
+		{
+			uint8_t f = 0;
+			if (outBits & (1 << l))
+			{
+				f |= POINT_OUTSIDE;
+				test.outside++;
+			}
+			else if (onBits & (1 << l))
+				test.onEdge++;
+			else
+				test.inside++;
+
+			if (onBits & (1 << l))
+				f |= POINT_ON_EDGE;
+			flags[p + l] = f;
+		}
+	}
+
+	return test;
+}
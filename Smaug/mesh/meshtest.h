@@ -6,6 +6,9 @@ bool pointInConvexMeshPartNoEdges(meshPart_t* part, glm::vec3 pos);
 bool pointInConvexLoop(vertex_t* vert, glm::vec3 pos);
 bool pointInConvexLoopNoEdges(vertex_t* vert, glm::vec3 pos);
 
+// Tests against the part's flattened outline, so it works on concave parts too. pos should already be on the part's plane
+bool pointInPartOutline(meshPart_t* part, glm::vec3 pos);
+
 inline bool pointInConvexLoop(halfEdge_t* he, glm::vec3 pos) { return pointInConvexLoop(he->vert, pos); };
 inline bool pointInConvexMeshFace(face_t* face, glm::vec3 pos) { return pointInConvexLoop(face->verts.front(), pos); }
 
@@ -19,3 +22,41 @@ struct pointInConvexTest_t
 
 pointInConvexTest_t pointInConvexLoopQuery(vertex_t* vert, glm::vec3 pos);
 pointInConvexTest_t pointInConvexLoopQueryIgnoreNonOuterEdges(vertex_t* vert, glm::vec3 pos);
+
+
+// Batch point in convex tests
+// Pulls a convex loop's edges out once, then runs a whole batch of points against them at once
+
+// A convex loop's edges, laid out a component at a time
+struct convexLoopPlanes_t
+{
+	// Where each edge starts
+	std::vector<float> startX, startY, startZ;
+
+	// Points out of the loop, along its plane. A point is out past an edge when dot(pos - start, perp) > 0
+	std::vector<float> perpX, perpY, perpZ;
+
+	// Whether landing right on the edge counts as on edge, or just inside
+	std::vector<bool> countsOnEdge;
+};
+
+// Points to test, laid out a component at a time. Padded out so the SIMD never runs off the end
+struct convexPoints_t
+{
+	std::vector<float> x, y, z;
+	size_t count = 0;
+};
+
+// Per point flags out of pointsInConvexLoopQuery. Neither means inside
+#define POINT_OUTSIDE 1
+#define POINT_ON_EDGE 2
+
+// Pulls the edges out of the loop vert is in. With ignoreNonOuterEdges, paired edges can't put a point on edge, same as pointInConvexLoopQueryIgnoreNonOuterEdges
+void convexLoopPlanes(vertex_t* vert, convexLoopPlanes_t& planes, bool ignoreNonOuterEdges = false);
+
+void convexPointsClear(convexPoints_t& points);
+void convexPointsAdd(convexPoints_t& points, glm::vec3 pos);
+
+// Runs every point against the planes. Fills flags with POINT_OUTSIDE and POINT_ON_EDGE for each point
+// The counts that come back are of points, not edges. Each point lands in exactly one of them
+pointInConvexTest_t pointsInConvexLoopQuery(const convexLoopPlanes_t& planes, const convexPoints_t& points, uint8_t* flags);
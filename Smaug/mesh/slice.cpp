@@ -706,24 +706,41 @@ pointInConvexTest_t faceInFacesQueryTest(face_t* inside, std::vector<face_t*>& f
 		return {};
 
 	glm::vec3 shift = parentMesh(inside)->origin - parentMesh(faces.front())->origin;
-	pointInConvexTest_t test;
+
+	// Every point is outside until one of the faces takes it
+	// Only the points nobody's taken yet get run against the next face
+	convexPoints_t points;
 	for (auto v : inside->verts)
+		convexPointsAdd(points, *v->vert + shift);
+
+	pointInConvexTest_t test;
+	convexLoopPlanes_t planes;
+	std::vector<uint8_t> flags(points.x.size());
+	for (auto c : faces)
 	{
-		pointInConvexTest_t t;
-		for (auto c : faces)
+		convexLoopPlanes(c->verts.front(), planes, true);
+		pointInConvexTest_t t = pointsInConvexLoopQuery(planes, points, flags.data());
+		test.onEdge += t.onEdge;
+		test.inside += t.inside;
+		if (t.outside == 0)
+			return test;
+
+		// Pack whoever's still out down to the front for the next face
+		size_t kept = 0;
+		for (size_t i = 0; i < points.count; i++)
 		{
-			t = pointInConvexLoopQueryIgnoreNonOuterEdges(c->verts.front(), *v->vert + shift);
-			if (t.outside == 0)
-				break;
+			if (!(flags[i] & POINT_OUTSIDE))
+				continue;
+			points.x[kept] = points.x[i];
+			points.y[kept] = points.y[i];
+			points.z[kept] = points.z[i];
+			kept++;
 		}
-		if (t.outside)
-			test.outside++;
-		else if (t.onEdge)
-			test.onEdge++;
-		else
-			test.inside++;
+		points.count = kept;
 	}
 
+	// Nobody took these
+	test.outside += points.count;
 	return test;
 }
 
@@ -835,7 +852,8 @@ void applyCuts(cuttableMesh_t* mesh, std::vector<mesh_t*>& cutters)
 						copyCat = new inCutFace_t;
 						cloneFaceInto(face, copyCat);
 						coll.push_back(copyCat);
-						convexifyMeshPartFaces(*part, coll);// , []() { return (face_t*)new inCutFace_t; });
+						// Cloning drops the crack pairs, so the partitioner can't see holes here. Greedy copes fine
+						convexifyMeshPartFacesGreedy(*part, coll);// , []() { return (face_t*)new inCutFace_t; });
 
 						// Only want to regen this data when we need to
 						didSlice = false;
@@ -4,15 +4,10 @@
 #include "log.h"
 
 #include <glm/geometric.hpp>
-
-// Move this to util or something?
-template<typename T>
-void swap(T& a, T& b)
-{
-	T temp = a;
-	a = b;
-	b = temp;
-}
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <algorithm>
+#include <set>
 
 ///////////////////////
 // Mesh face slicing //
@@ -99,7 +94,7 @@ face_t* sliceMeshPartFace(meshPart_t& mesh, std::vector<face_t*>& faceVec, face_
 	// Start should always be the clockwise start of the smaller part
 	if (between < face->edges.size() / 2.0f)
 	{
-		swap(start, end);
+		std::swap(start, end);
 	}
 
 	// Now that we know which side's larger, we can safely slice
@@ -160,113 +155,687 @@ halfEdge_t* fuseEdges(face_t* face, vertex_t* stem)
 // Mesh face triangulation //
 /////////////////////////////
 
-// Clean this all up!!
-// Takes in a mesh part and triangulates every face within the part
-// TODO: This might need a check for parallel lines!
-void triangluateMeshPartFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec)
+// Monotone partition triangulation. See Computational Geometry: Algorithms and Applications, chapter 3
+// Faces are flattened onto 2D, swept top to bottom to split them into y-monotone pieces, and each piece is then triangulated in a single pass
+// Runs in O(n log n), and cracks in a face are just treated as holes
+
+enum class monoVertType_t : char
 {
-	// As we'll be walking this, we wont want to walk over our newly created faces
-	// Store our len so we only get to the end of the predefined faces
-	size_t len = faceVec.size();
-	for (size_t i = 0; i < len; i++)
+	START,
+	END,
+	SPLIT,
+	MERGE,
+	REGULAR_LEFT,  // Interior is to the right
+	REGULAR_RIGHT, // Interior is to the left
+};
+
+// Is a above b? Ties go to the leftmost point, so no two distinct points ever compare equal
+static inline bool monoAbove(glm::vec2 a, glm::vec2 b)
+{
+	return a.y > b.y || (a.y == b.y && a.x < b.x);
+}
+
+// Positive if b is to the right of o->a when o->a is heading downwards
+static inline float monoCross(glm::vec2 o, glm::vec2 a, glm::vec2 b)
+{
+	return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+struct monoQuery_t
+{
+	glm::vec2 p;
+};
+
+// Orders the edges crossing the sweep line from left to right
+// Edges are keyed by the index of the vert they stem out of, and always head downwards
+struct monoStatusCmp_t
+{
+	using is_transparent = void;
+
+	const glm::vec2* pts;
+	const int* next;
+
+	bool operator()(int l, int r) const
 	{
-		face_t* face = faceVec[i];
-		if (!face)
+		if (l == r)
+			return false;
+
+		glm::vec2 l0 = pts[l], l1 = pts[next[l]];
+		glm::vec2 r0 = pts[r], r1 = pts[next[r]];
+
+		// Whichever edge started lower is within the span of the other
+		if (monoAbove(r0, l0))
+			return monoCross(r0, r1, l0) < 0;
+		else if (monoAbove(l0, r0))
+			return monoCross(l0, l1, r0) > 0;
+		return monoCross(l0, l1, r1) > 0;
+	}
+	bool operator()(int e, monoQuery_t q) const { return monoCross(pts[e], pts[next[e]], q.p) > 0; }
+	bool operator()(monoQuery_t q, int e) const { return monoCross(pts[e], pts[next[e]], q.p) < 0; }
+};
+
+// Circular angle order of directions starting from +x
+static inline bool monoAngleLess(glm::vec2 a, glm::vec2 b)
+{
+	bool aLow = a.y < 0 || (a.y == 0 && a.x < 0);
+	bool bLow = b.y < 0 || (b.y == 0 && b.x < 0);
+	if (aLow != bLow)
+		return bLow;
+	return a.x * b.y - a.y * b.x > 0;
+}
+
+// Splits the loops into monotone pieces, adding the diagonals to outDiagonals
+static bool monotonePartition(const std::vector<glm::vec2>& pts, const std::vector<int>& next, const std::vector<int>& prev, std::vector<monoVertType_t>& types, std::vector<std::pair<int, int>>& outDiagonals)
+{
+	int count = pts.size();
+
+	// Figure out what every vert is
+	types.resize(count);
+	for (int v = 0; v < count; v++)
+	{
+		glm::vec2 p = pts[v];
+		glm::vec2 u = pts[prev[v]];
+		glm::vec2 w = pts[next[v]];
+
+		bool uBelow = monoAbove(p, u);
+		bool wBelow = monoAbove(p, w);
+		float turn = monoCross(u, p, w);
+
+		if (uBelow == wBelow)
+		{
+			// Spikes have no inside for us to work with
+			if (turn == 0)
+				return false;
+
+			if (uBelow)
+				types[v] = turn > 0 ? monoVertType_t::START : monoVertType_t::SPLIT;
+			else
+				types[v] = turn > 0 ? monoVertType_t::END : monoVertType_t::MERGE;
+		}
+		else
+			types[v] = uBelow ? monoVertType_t::REGULAR_RIGHT : monoVertType_t::REGULAR_LEFT;
+	}
+
+	std::vector<int> order(count);
+	for (int i = 0; i < count; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		if (monoAbove(pts[a], pts[b])) return true;
+		if (monoAbove(pts[b], pts[a])) return false;
+		return a < b;
+	});
+
+	monoStatusCmp_t cmp{ pts.data(), next.data() };
+	std::set<int, monoStatusCmp_t> status(cmp);
+	std::vector<std::set<int, monoStatusCmp_t>::iterator> statusIt(count, status.end());
+	std::vector<int> helper(count, -1);
+
+	auto insertEdge = [&](int e) {
+		statusIt[e] = status.insert(e).first;
+		helper[e] = e;
+	};
+	auto removeEdge = [&](int e, int v) {
+		if (statusIt[e] == status.end())
+			return false;
+		if (types[helper[e]] == monoVertType_t::MERGE)
+			outDiagonals.push_back({ v, helper[e] });
+		status.erase(statusIt[e]);
+		statusIt[e] = status.end();
+		return true;
+	};
+	// Edge directly to the left of v
+	auto leftEdge = [&](int v) {
+		auto it = status.lower_bound(monoQuery_t{ pts[v] });
+		if (it == status.begin())
+			return -1;
+		return *--it;
+	};
+
+	for (int v : order)
+	{
+		switch (types[v])
+		{
+		case monoVertType_t::START:
+			insertEdge(v);
+			break;
+		case monoVertType_t::END:
+			if (!removeEdge(prev[v], v))
+				return false;
+			break;
+		case monoVertType_t::SPLIT:
+		{
+			int e = leftEdge(v);
+			if (e == -1)
+				return false;
+			outDiagonals.push_back({ v, helper[e] });
+			helper[e] = v;
+			insertEdge(v);
+			break;
+		}
+		case monoVertType_t::MERGE:
+		{
+			if (!removeEdge(prev[v], v))
+				return false;
+			int e = leftEdge(v);
+			if (e == -1)
+				return false;
+			if (types[helper[e]] == monoVertType_t::MERGE)
+				outDiagonals.push_back({ v, helper[e] });
+			helper[e] = v;
+			break;
+		}
+		case monoVertType_t::REGULAR_LEFT:
+			if (!removeEdge(prev[v], v))
+				return false;
+			insertEdge(v);
+			break;
+		case monoVertType_t::REGULAR_RIGHT:
+		{
+			int e = leftEdge(v);
+			if (e == -1)
+				return false;
+			if (types[helper[e]] == monoVertType_t::MERGE)
+				outDiagonals.push_back({ v, helper[e] });
+			helper[e] = v;
+			break;
+		}
+		}
+	}
+
+	// Anything left over means the loops crossed themselves somewhere
+	return status.empty();
+}
+
+// Triangulates a y-monotone loop of verts, wound with its inside to the left
+static bool triangulateMonotone(const std::vector<glm::vec2>& pts, const std::vector<int>& loop, std::vector<int>& outTris)
+{
+	int count = loop.size();
+	if (count < 3)
+		return false;
+
+	auto emit = [&](int a, int b, int c) {
+		if (monoCross(pts[a], pts[b], pts[c]) < 0)
+			std::swap(b, c);
+		outTris.push_back(a);
+		outTris.push_back(b);
+		outTris.push_back(c);
+	};
+
+	if (count == 3)
+	{
+		emit(loop[0], loop[1], loop[2]);
+		return true;
+	}
+
+	int top = 0, bottom = 0;
+	for (int i = 1; i < count; i++)
+	{
+		if (monoAbove(pts[loop[i]], pts[loop[top]]))
+			top = i;
+		if (monoAbove(pts[loop[bottom]], pts[loop[i]]))
+			bottom = i;
+	}
+
+	// Going forwards from the top walks down the left chain, and backwards walks down the right
+	// Merge the two chains together into one sorted run
+	std::vector<int> sorted;
+	std::vector<bool> onLeft;
+	sorted.reserve(count);
+	onLeft.reserve(count);
+	sorted.push_back(loop[top]);
+	onLeft.push_back(true);
+
+	int l = (top + 1) % count;
+	int r = (top + count - 1) % count;
+	while (sorted.size() < (size_t)count)
+	{
+		bool takeLeft;
+		if (l == bottom)
+			takeLeft = r == bottom;
+		else if (r == bottom)
+			takeLeft = true;
+		else
+			takeLeft = monoAbove(pts[loop[l]], pts[loop[r]]);
+
+		// Chains must strictly head down or this was never monotone
+		int take = loop[takeLeft ? l : r];
+		if (!monoAbove(pts[sorted.back()], pts[take]))
+			return false;
+
+		if (takeLeft)
+		{
+			sorted.push_back(loop[l]);
+			onLeft.push_back(true);
+			if (l == bottom)
+				break;
+			l = (l + 1) % count;
+		}
+		else
+		{
+			sorted.push_back(loop[r]);
+			onLeft.push_back(false);
+			r = (r + count - 1) % count;
+		}
+	}
+	if (sorted.size() != (size_t)count)
+		return false;
+
+	std::vector<int> stack;
+	stack.reserve(count);
+	stack.push_back(0);
+	stack.push_back(1);
+
+	for (int j = 2; j < count - 1; j++)
+	{
+		if (onLeft[j] != onLeft[stack.back()])
+		{
+			// Opposite chain. Fan out to everything on the stack
+			while (stack.size() > 1)
+			{
+				int a = stack.back();
+				stack.pop_back();
+				emit(sorted[j], sorted[a], sorted[stack.back()]);
+			}
+			stack.clear();
+			stack.push_back(j - 1);
+			stack.push_back(j);
+		}
+		else
+		{
+			// Same chain. Cut off everything we can see
+			int last = stack.back();
+			stack.pop_back();
+			while (stack.size())
+			{
+				float side = monoCross(pts[sorted[stack.back()]], pts[sorted[j]], pts[sorted[last]]);
+				if (onLeft[j] ? side >= 0 : side <= 0)
+					break;
+				emit(sorted[j], sorted[last], sorted[stack.back()]);
+				last = stack.back();
+				stack.pop_back();
+			}
+			stack.push_back(last);
+			stack.push_back(j);
+		}
+	}
+
+	// Fan the bottom out to whatever's left
+	for (size_t i = 0; i + 1 < stack.size(); i++)
+		emit(sorted[count - 1], sorted[stack[i]], sorted[stack[i + 1]]);
+
+	return true;
+}
+
+bool triangulateFace(face_t* face, glm::vec3 normal, std::vector<glm::vec3*>& outTris)
+{
+	if (!face || face->edges.size() < 3)
+		return false;
+
+	// Flatten down onto whichever axis we face the most
+	glm::vec3 absNorm = glm::abs(normal);
+	int dropped = 2;
+	if (absNorm.x >= absNorm.y && absNorm.x >= absNorm.z)
+		dropped = 0;
+	else if (absNorm.y >= absNorm.z)
+		dropped = 1;
+	int nU = (dropped + 1) % 3;
+	int nV = (dropped + 2) % 3;
+
+	// NaN normals won't flatten to anything useful
+	if (!(absNorm[dropped] > 0))
+		return false;
+
+	// Split the face into its loops by stepping over the bridges cracks leave behind
+	std::vector<glm::vec2> pts;
+	std::vector<glm::vec3*> ptVerts;
+	std::vector<int> next, prev;
+	std::vector<int> loopStarts;
+	pts.reserve(face->edges.size());
+	ptVerts.reserve(face->edges.size());
+
+	auto isBridge = [face](halfEdge_t* e) { return e->pair && e->pair->face == face; };
+
+	// Faces without cracks are only one loop, so there's no need to keep track of what we've walked
+	size_t bridgeCount = 0;
+	for (auto e : face->edges)
+		if (isBridge(e))
+			bridgeCount++;
+
+	std::vector<halfEdge_t*> sortedEdges;
+	std::vector<bool> walked;
+	if (bridgeCount)
+	{
+		sortedEdges = face->edges;
+		std::sort(sortedEdges.begin(), sortedEdges.end());
+		walked.resize(sortedEdges.size());
+	}
+	auto walkedIndex = [&](halfEdge_t* e) {
+		return std::lower_bound(sortedEdges.begin(), sortedEdges.end(), e) - sortedEdges.begin();
+	};
+
+	for (auto start : face->edges)
+	{
+		if (isBridge(start))
 			continue;
-		
-		// Discard Tris
-		if (face->edges.size() < 4)
+		if (bridgeCount && walked[walkedIndex(start)])
 			continue;
 
-		
-		// Get the norm of the face for later testing 
-		glm::vec3 faceNorm = faceNormal(face);
-		
-		//int nU, nV;
-		//findDominantAxis(faceNorm, nU, nV);
+		int first = pts.size();
+		loopStarts.push_back(first);
 
-		// On odd numbers, we use start + 1, end instead of start, end - 1
-		// Makes it look a bit like we're fitting quads instead of tris
-		int alternate = 0;
+		halfEdge_t* e = start;
+		do
+		{
+			if (pts.size() >= face->edges.size())
+				return false;
+			if (bridgeCount)
+			{
+				size_t i = walkedIndex(e);
+				if (i == sortedEdges.size() || sortedEdges[i] != e || walked[i])
+					return false;
+				walked[i] = true;
+			}
 
+			glm::vec3* vert = e->vert->vert;
+			pts.push_back({ (*vert)[nU], (*vert)[nV] });
+			ptVerts.push_back(vert);
 
-		// In these loop, we'll progressively push the original face to become smaller and smaller
-		while (face->verts.size() > 3)
+			e = e->next;
+			for (size_t sanity = 0; isBridge(e); sanity++)
+			{
+				if (sanity > face->edges.size())
+					return false;
+				e = e->pair->next;
+			}
+		} while (e != start);
+
+		int last = pts.size() - 1;
+		for (int i = first; i <= last; i++)
 		{
-			// Vert 0 will become our anchor for all new faces to connect to
-			vertex_t* end = face->verts[face->verts.size() - 1 - fmod(alternate, 2)];
-			vertex_t* v0 = end->edge->next->vert;
+			next.push_back(i == last ? first : i + 1);
+			prev.push_back(i == first ? last : i - 1);
+		}
 
+		// Uncracked loops that don't use every edge aren't a face we can make sense of
+		if (!bridgeCount)
+		{
+			if (pts.size() != face->edges.size())
+				return false;
+			break;
+		}
+	}
+	loopStarts.push_back(pts.size());
 
-			int attempts = 0;
-			bool shift;
-			do{
-				shift = false;
+	// Outer loops wind one way and holes wind the other
+	// Flip it all if we flattened from behind
+	std::vector<float> loopArea(loopStarts.size() - 1);
+	float totalArea = 0;
+	for (size_t i = 0; i + 1 < loopStarts.size(); i++)
+	{
+		float area = 0;
+		for (int v = loopStarts[i]; v < loopStarts[i + 1]; v++)
+			area += pts[v].x * pts[next[v]].y - pts[next[v]].x * pts[v].y;
+		loopArea[i] = area;
+		totalArea += area;
+	}
+	if (totalArea == 0)
+		return false;
+	if (totalArea < 0)
+	{
+		for (auto& p : pts)
+			p.x = -p.x;
+		for (auto& a : loopArea)
+			a = -a;
+	}
 
-				// Will this be concave?
-				vertex_t* between = end->edge->vert;
-				glm::vec3 edge1 = (*end->vert) - (*between->vert);
-				glm::vec3 edge2 = (*between->vert) - (*v0->vert);
-				glm::vec3 triNormal = glm::cross(edge1, edge2);
+	// Plain convex faces can just be fanned
+	if (loopArea.size() == 1)
+	{
+		bool convex = true;
+		for (int v = 0; v < (int)pts.size() && convex; v++)
+		{
+			glm::vec2 u = pts[prev[v]], p = pts[v], w = pts[next[v]];
+			float turn = monoCross(u, p, w);
+			convex = turn > 0 || (turn == 0 && glm::dot(p - u, w - p) > 0);
+		}
 
-				//SASSERT(triNormal.x != 0 || triNormal.y != 0 || triNormal.z != 0);
+		if (convex)
+		{
+			outTris.reserve(outTris.size() + (pts.size() - 2) * 3);
+			for (int i = 1; i + 1 < (int)pts.size(); i++)
+			{
+				outTris.push_back(ptVerts[0]);
+				outTris.push_back(ptVerts[i]);
+				outTris.push_back(ptVerts[i + 1]);
+			}
+			return true;
+		}
+	}
 
-				// If we get a zero area tri, WHICH WE SHOULD NOT PASS IN OR CREATE, trim it off
-				if (triNormal.x == 0 && triNormal.y == 0 && triNormal.z == 0)
-				{
-					//SASSERT(0);
+	// Every outer loop costs us two tris, and every hole gives us two more
+	int expectedTris = pts.size();
+	for (auto a : loopArea)
+	{
+		if (a == 0)
+			return false;
+		expectedTris += a > 0 ? -2 : 2;
+	}
 
-					// Fuse v0 and end together 
-					fuseEdges(face, end);
+	std::vector<monoVertType_t> types;
+	std::vector<std::pair<int, int>> diagonals;
+	if (!monotonePartition(pts, next, prev, types, diagonals))
+		return false;
 
-					goto escapeTri;
-				}
+	// Wire the loops and diagonals up into a graph, with each vert's edges sorted by angle
+	// Walking it with the inside on the left gives us our monotone pieces
+	struct monoEdge_t
+	{
+		int from, to;
+		bool visited;
+	};
+	std::vector<monoEdge_t> edges;
+	edges.reserve(pts.size() + diagonals.size() * 2);
+	for (int v = 0; v < (int)pts.size(); v++)
+		edges.push_back({ v, next[v], false });
+	for (auto d : diagonals)
+	{
+		if (d.first == d.second)
+			return false;
+		edges.push_back({ d.first, d.second, false });
+		edges.push_back({ d.second, d.first, false });
+	}
 
-				float dot = glm::dot(triNormal, faceNorm);
-				if (dot < 0)
-					shift = true;
-				else
-				{
-					// Dot was fine. Let's see if anything's in our new tri
+	// Most verts only have their loop edge. Only diagonal verts need to pick
+	// Each vert's edges are packed together, starting with its loop edge
+	std::vector<int> fanStart(pts.size() + 1, 0);
+	for (size_t i = pts.size(); i < edges.size(); i++)
+		fanStart[edges[i].from + 1]++;
+	for (int v = 0; v < (int)pts.size(); v++)
+		fanStart[v + 1] += fanStart[v] + (fanStart[v + 1] ? 1 : 0);
+
+	std::vector<int> fans(fanStart.back());
+	std::vector<int> fanFill(fanStart.begin(), fanStart.end() - 1);
+	for (int v = 0; v < (int)pts.size(); v++)
+		if (fanStart[v + 1] != fanStart[v])
+			fans[fanFill[v]++] = v;
+	for (size_t i = pts.size(); i < edges.size(); i++)
+		fans[fanFill[edges[i].from]++] = i;
+
+	for (int v = 0; v < (int)pts.size(); v++)
+	{
+		std::sort(fans.begin() + fanStart[v], fans.begin() + fanStart[v + 1], [&](int a, int b) {
+			return monoAngleLess(pts[edges[a].to] - pts[v], pts[edges[b].to] - pts[v]);
+		});
+	}
 
-					//glm::vec3 u = tritod(*end->vert, *between->vert, *v0->vert, nU);
-					//glm::vec3 v = tritod(*end->vert, *between->vert, *v0->vert, nV);
+	// Next edge clockwise from where we came from
+	auto nextEdge = [&](int e) {
+		int v = edges[e].to;
+		auto begin = fans.begin() + fanStart[v];
+		auto end = fans.begin() + fanStart[v + 1];
+		if (begin == end)
+			return v;
+
+		glm::vec2 back = pts[edges[e].from] - pts[v];
+		auto it = std::lower_bound(begin, end, back, [&](int a, glm::vec2 dir) {
+			return monoAngleLess(pts[edges[a].to] - pts[v], dir);
+		});
+		if (it == begin)
+			it = end;
+		return *--it;
+	};
+
+	size_t firstTri = outTris.size();
+	std::vector<int> tris;
+	std::vector<int> piece;
+	for (size_t i = 0; i < edges.size(); i++)
+	{
+		if (edges[i].visited)
+			continue;
 
-					// I fear the cache misses...
-					for (vertex_t* c = v0->edge->vert; c != end; c = c->edge->vert)
-					{
-						glm::vec3 ptt = *c->vert;
-						if (testPointInTriNoEdges(ptt, *end->vert, *between->vert, *v0->vert))//(ptt[nU], ptt[nV], u, v))
-						{
-							shift = true;
-							break;
-						}
-					}
-				}
+		piece.clear();
+		int e = i;
+		do
+		{
+			if (edges[e].visited)
+				return false;
+			edges[e].visited = true;
+			piece.push_back(edges[e].from);
+			e = nextEdge(e);
+		} while (e != (int)i);
+
+		if (!triangulateMonotone(pts, piece, tris))
+			return false;
+	}
 
-				if (shift)
-				{
-					// Shift to somewhere it shouldn't be concave
-					v0 = v0->edge->vert;
-					end = end->edge->vert;
-					attempts++;
-				}
+	if (tris.size() != (size_t)expectedTris * 3)
+		return false;
+
+	// Back to our real verts
+	outTris.reserve(firstTri + tris.size());
+	for (auto t : tris)
+		outTris.push_back(ptVerts[t]);
+
+	return true;
+}
+
+// Maps the verts a part's faces use back onto the part's tri indices
+// Sorted by pointer, so we can binary search it
+typedef std::vector<std::pair<glm::vec3*, uint32_t>> partVertLookup_t;
+
+static void buildPartVertLookup(meshPart_t& mesh, partVertLookup_t& lookup)
+{
+	lookup.clear();
+	lookup.reserve(mesh.verts.size() + (mesh.sliced ? mesh.sliced->cutVerts.size() : 0));
+
+	uint32_t index = 0;
+	for (auto v : mesh.verts)
+		lookup.push_back({ v->vert, index++ });
+	if (mesh.sliced)
+		for (auto v : mesh.sliced->cutVerts)
+			lookup.push_back({ v, index++ });
+
+	std::sort(lookup.begin(), lookup.end());
+}
+
+static bool findPartVert(partVertLookup_t& lookup, glm::vec3* vert, uint32_t& index)
+{
+	auto f = std::lower_bound(lookup.begin(), lookup.end(), std::pair<glm::vec3*, uint32_t>{ vert, 0 });
+	if (f == lookup.end() || f->first != vert)
+		return false;
+	index = f->second;
+	return true;
+}
+
+// Fans out every convex face straight into indices
+static void fanConvexFaces(partVertLookup_t& lookup, std::vector<face_t*>& faceVec, std::vector<uint32_t>& outIndices)
+{
+	std::vector<uint32_t> loop;
+	for (auto face : faceVec)
+	{
+		if (!face || face->verts.size() < 3)
+			continue;
+
+		loop.clear();
+		vertex_t* vs = face->verts.front(), *v = vs;
+		do
+		{
+			uint32_t index;
+			if (!findPartVert(lookup, v->vert, index))
+			{
+				Log::Fault("[Tessellate] Face refering to vert not in its part!!\n");
+				loop.clear();
+				break;
 			}
-			while (shift && attempts < 10);
+			loop.push_back(index);
+			v = v->edge->vert;
+		} while (v != vs && loop.size() <= face->verts.size());
 
-			// Wouldn't it just be better to implement a quick version for triangulate? We're doing a lot of slices? Maybe just a bulk slicer?
-			sliceMeshPartFaceUnsafe(mesh, faceVec, face, v0, end);
+		for (size_t i = 1; i + 1 < loop.size(); i++)
+		{
+			outIndices.push_back(loop[0]);
+			outIndices.push_back(loop[i]);
+			outIndices.push_back(loop[i + 1]);
+		}
+	}
+}
 
-			escapeTri:
-			alternate++;
-		};
+// Takes in a mesh part and triangulates every face within faceVec, leaving the faces themselves untouched
+// Faces can only use the part's verts and cut verts
+void triangluateMeshPartFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec, std::vector<uint32_t>& outIndices)
+{
+	partVertLookup_t lookup;
+	buildPartVertLookup(mesh, lookup);
 
-		
+	std::vector<glm::vec3*> tris;
+	for (auto face : faceVec)
+	{
+		if (!face)
+			continue;
+
+		tris.clear();
+		if (triangulateFace(face, mesh.normal, tris))
+		{
+			outIndices.reserve(outIndices.size() + tris.size());
+			for (size_t i = 0; i < tris.size(); i += 3)
+			{
+				uint32_t a, b, c;
+				if (!findPartVert(lookup, tris[i], a) || !findPartVert(lookup, tris[i + 1], b) || !findPartVert(lookup, tris[i + 2], c))
+				{
+					Log::Fault("[Tessellate] Face refering to vert not in its part!!\n");
+					continue;
+				}
+				outIndices.push_back(a);
+				outIndices.push_back(b);
+				outIndices.push_back(c);
+			}
+			continue;
+		}
+
+		// Face is too messed up to sweep. Fall back on cutting it into convex pieces and fanning those
+		std::vector<face_t*> temp;
+		face_t* f = new face_t;
+		cloneFaceInto(face, f);
+		f->parent = face;
+		temp.push_back(f);
+		optimizeParallelEdges(&mesh, temp);
+		convexifyMeshPartFacesGreedy(mesh, temp);
+		fanConvexFaces(lookup, temp, outIndices);
+		for (auto t : temp)
+			delete t;
 	}
+}
 
+// Not for use on concaves!
+void triangluateMeshPartConvexFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec, std::vector<uint32_t>& outIndices)
+{
+	partVertLookup_t lookup;
+	buildPartVertLookup(mesh, lookup);
+	fanConvexFaces(lookup, faceVec, outIndices);
 }
 
 // Not for use on concaves!
+// Slices the faces up into real tris, for when we need the half edges of them
 void triangluateMeshPartConvexFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec)
 {
 	// As we'll be walking this, we wont want to walk over our newly created faces
@@ -294,7 +863,6 @@ void triangluateMeshPartConvexFaces(meshPart_t& mesh, std::vector<face_t*>& face
 			vertex_t* end = face->verts[face->verts.size() - 1 - fmod(alternate, 2)];
 			vertex_t* v0 = end->edge->next->vert;
 
-			// Wouldn't it just be better to implement a quick version for triangulate? We're doing a lot of slices? Maybe just a bulk slicer?
 			sliceMeshPartFaceUnsafe(mesh, faceVec, face, v0, end);
 
 			alternate++;
@@ -305,9 +873,260 @@ void triangluateMeshPartConvexFaces(meshPart_t& mesh, std::vector<face_t*>& face
 
 }
 
+///////////////////////////////////
+// Mesh face convex partitioning //
+///////////////////////////////////
+
+// Hertel-Mehlhorn. Triangulate, then throw out every diagonal that isn't holding up a concave corner
+// Never more than four times the minimum number of pieces, and usually right on it
+
+// Half edge of a tri, indexed by where it sits in the tri list
+struct partitionEdge_t
+{
+	glm::vec3* from;
+	glm::vec3* to;
+	int next;
+	int prev;
+	int twin; // The other side of a diagonal. -1 if this is on the face's border
+	bool alive;
+};
+
+// An edge by its end points, and where to find it. Sorted so we can binary search it
+typedef std::pair<std::pair<glm::vec3*, glm::vec3*>, int> partitionKey_t;
+
+static int findPartitionKey(std::vector<partitionKey_t>& keys, glm::vec3* from, glm::vec3* to)
+{
+	auto f = std::lower_bound(keys.begin(), keys.end(), partitionKey_t{ { from, to }, 0 });
+	if (f == keys.end() || f->first.first != from || f->first.second != to)
+		return -1;
+	return f->second;
+}
+
+// No concave corners and no cracks
+static bool partitionFaceIsConvex(face_t* face, glm::vec3 normal)
+{
+	for (auto v : face->verts)
+	{
+		halfEdge_t* e = v->edge;
+		if (e->pair && e->pair->face == face)
+			return false;
+
+		glm::vec3 a = *v->vert, b = *e->vert->vert, c = *e->next->vert->vert;
+		if (glm::dot(glm::cross(b - a, c - b), normal) < 0)
+			return false;
+	}
+	return true;
+}
+
+// Splits a face into convex pieces, leaving the face itself untouched
+bool convexPartitionFace(meshPart_t& mesh, face_t* face, std::vector<face_t*>& outPieces)
+{
+	// Most faces are convex to begin with. They don't need triangulating
+	if (partitionFaceIsConvex(face, mesh.normal))
+	{
+		face_t* piece = new face_t;
+		cloneFaceInto(face, piece);
+		piece->flags &= ~FaceFlags::FF_MESH_PART;
+		piece->flags |= FaceFlags::FF_CONVEX;
+		outPieces.push_back(piece);
+		return true;
+	}
+
+	std::vector<glm::vec3*> tris;
+	if (!triangulateFace(face, mesh.normal, tris) || tris.size() == 0)
+		return false;
+
+	int count = tris.size();
+	std::vector<partitionEdge_t> edges(count);
+	std::vector<partitionKey_t> keys(count);
+	for (int t = 0; t < count; t += 3)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			int e = t + i;
+			int next = t + (i + 1) % 3;
+			int prev = t + (i + 2) % 3;
+			edges[e] = { tris[e], tris[next], next, prev, -1, true };
+			keys[e] = { { tris[e], tris[next] }, e };
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+
+	// Any edge that runs back along another tri's edge is a diagonal
+	for (auto& e : edges)
+		e.twin = findPartitionKey(keys, e.to, e.from);
+
+	// Straight corners are fine. The loop was cleaned before we got here, so they only turn up where a diagonal meets the border
+	glm::vec3 normal = mesh.normal;
+	auto convexCorner = [&](int in, int out)
+	{
+		glm::vec3 a = *edges[in].from, b = *edges[out].from, c = *edges[out].to;
+		return glm::dot(glm::cross(b - a, c - b), normal) >= 0;
+	};
+
+	// Throw out every diagonal we can without going concave at either end of it
+	for (int h = 0; h < count; h++)
+	{
+		int t = edges[h].twin;
+
+		// Only visit each diagonal once
+		if (t < h || edges[t].twin != h)
+			continue;
+
+		partitionEdge_t& he = edges[h];
+		partitionEdge_t& te = edges[t];
+		if (he.next == t || te.next == h)
+			continue;
+
+		if (!convexCorner(he.prev, te.next) || !convexCorner(te.prev, he.next))
+			continue;
+
+		edges[he.prev].next = te.next;
+		edges[te.next].prev = he.prev;
+		edges[te.prev].next = he.next;
+		edges[he.next].prev = te.prev;
+		he.alive = false;
+		te.alive = false;
+	}
+
+	// Everything left on the border keeps the flags of the face's edge it came from
+	// Crack bridges don't make it out of the triangulation, so they're left out
+	std::vector<partitionKey_t> border;
+	border.reserve(face->verts.size());
+	for (int i = 0; i < (int)face->verts.size(); i++)
+	{
+		halfEdge_t* e = face->verts[i]->edge;
+		if (e->pair && e->pair->face == face)
+			continue;
+		border.push_back({ { face->verts[i]->vert, e->vert->vert }, i });
+	}
+	std::sort(border.begin(), border.end());
+
+	// Walk what's left into faces
+	size_t firstPiece = outPieces.size();
+	std::vector<halfEdge_t*> made(count, nullptr);
+	bool failed = false;
+	for (int s = 0; s < count && !failed; s++)
+	{
+		if (!edges[s].alive || made[s])
+			continue;
+
+		face_t* piece = new face_t;
+		piece->parent = face->parent;
+		piece->flags = face->flags;
+		piece->flags &= ~FaceFlags::FF_MESH_PART;
+		piece->flags |= FaceFlags::FF_CONVEX;
+		outPieces.push_back(piece);
+
+		int e = s;
+		do
+		{
+			if (made[e])
+			{
+				failed = true;
+				break;
+			}
+
+			halfEdge_t* he = new halfEdge_t;
+			he->face = piece;
+
+			int b = edges[e].twin == -1 ? findPartitionKey(border, edges[e].from, edges[e].to) : -1;
+			if (b != -1)
+				he->flags = face->verts[b]->edge->flags;
+
+			piece->verts.push_back(new vertex_t{ edges[e].from, he });
+			piece->edges.push_back(he);
+			made[e] = he;
+
+			e = edges[e].next;
+		} while (e != s);
+
+		size_t n = piece->edges.size();
+		if (n < 3)
+			failed = true;
+		for (size_t i = 0; i < n; i++)
+		{
+			piece->edges[i]->next = piece->edges[(i + 1) % n];
+			piece->edges[i]->vert = piece->verts[(i + 1) % n];
+		}
+	}
+
+	if (failed)
+	{
+		Log::Warn("[Tessellate] Convex partition came out malformed\n");
+		for (size_t i = firstPiece; i < outPieces.size(); i++)
+			delete outPieces[i];
+		outPieces.resize(firstPiece);
+		return false;
+	}
+
+	// Pair up the diagonals that survived
+	for (int e = 0; e < count; e++)
+		if (edges[e].alive && edges[e].twin != -1)
+			made[e]->pair = made[edges[e].twin];
+
+	return true;
+}
+
+// Splits every face within faceVec into as few convex pieces as we can
+// Each face is rebuilt as its first piece, so anything pointing at it stays valid. The rest are pushed onto faceVec
+void convexifyMeshPartFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec)
+{
+	std::vector<face_t*> pieces;
+	std::vector<face_t*> stubborn;
+
+	size_t len = faceVec.size();
+	for (size_t i = 0; i < len; i++)
+	{
+		face_t* face = faceVec[i];
+		if (!face)
+			continue;
+
+		// Tris and already convex faces can stay as they are
+		if (face->edges.size() < 4 || partitionFaceIsConvex(face, mesh.normal))
+		{
+			face->flags |= FaceFlags::FF_CONVEX;
+			continue;
+		}
+
+		pieces.clear();
+		if (!convexPartitionFace(mesh, face, pieces))
+		{
+			// Leave it to the greedy convexer
+			stubborn.push_back(face);
+			continue;
+		}
+
+		// Move the first piece into the face
+		face_t* first = pieces.front();
+		for (auto e : face->edges)
+			delete e;
+		for (auto v : face->verts)
+			delete v;
+		face->edges.clear();
+		face->verts.clear();
+		face->edges.swap(first->edges);
+		face->verts.swap(first->verts);
+		for (auto e : face->edges)
+			e->face = face;
+		face->flags |= FaceFlags::FF_CONVEX;
+		delete first;
+
+		for (size_t p = 1; p < pieces.size(); p++)
+			faceVec.push_back(pieces[p]);
+	}
+
+	if (stubborn.size())
+	{
+		size_t had = stubborn.size();
+		convexifyMeshPartFacesGreedy(mesh, stubborn);
+		faceVec.insert(faceVec.end(), stubborn.begin() + had, stubborn.end());
+	}
+}
+
 // This function fits convex faces to the concave face
 // It might be slow, bench it later
-void convexifyMeshPartFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec)
+void convexifyMeshPartFacesGreedy(meshPart_t& mesh, std::vector<face_t*>& faceVec)
 {
 	
 	halfEdge_t gapFiller;
@@ -489,43 +1308,157 @@ void convexifyMeshPartFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec)
 
 }
 
-void optimizeParallelEdges(meshPart_t* part, std::vector<face_t*>& faceVec)
+////////////////////////////
+// Collinear edge merging //
+////////////////////////////
+
+static inline bool edgesCollinear(glm::vec3 in, glm::vec3 out)
 {
+	glm::vec3 c = glm::cross(in, out);
+	return c.x == 0 && c.y == 0 && c.z == 0;
+}
 
-	size_t len = faceVec.size();
-	for (size_t i = 0; i < len; i++)
-	{
-		face_t* face = faceVec[i];
-		if (!face)
-			continue;
+// Single pass around the loop. Kept verts go on a stack along with the direction of the edge coming into them,
+// and each new vert knocks off whatever it makes straight. Only the seam where the loop wraps around needs a second look
+void mergeCollinearEdges(face_t* face)
+{
+	// Discard Tris, they're already perfect
+	if (face->edges.size() < 4)
+		return;
 
-		vertex_t* vStart, * vert;
+	std::vector<vertex_t*> loop;
+	std::vector<bool> bridge;
+	loop.reserve(face->verts.size());
+	bridge.reserve(face->verts.size());
 
-	startOfLoop:
-		// Discard Tris, they're already perfect
-		if (face->edges.size() < 4)
-			continue;
+	vertex_t* vs = face->verts.front(), *v = vs;
+	do
+	{
+		// Anything touching a crack has to stay put, or the bridge loses its pair
+		halfEdge_t* e = v->edge;
+		loop.push_back(v);
+		bridge.push_back(e->pair && e->pair->face == face);
+		v = e->vert;
+	} while (v != vs && loop.size() <= face->verts.size());
+
+	int count = loop.size();
+	std::vector<int> kept;
+	std::vector<glm::vec3> inDir;
+	kept.reserve(count);
+	inDir.reserve(count);
+	int remaining = count;
+
+	auto pos = [&](int i) { return *loop[i]->vert; };
+
+	for (int c = 0; c < count; c++)
+	{
+		bool keepC = true;
+		while (kept.size() >= 2 && remaining > 3)
+		{
+			int a = kept[kept.size() - 2], b = kept.back();
+			if (bridge[a] || bridge[b] || !edgesCollinear(inDir.back(), pos(c) - pos(b)))
+				break;
 
-		vStart = face->verts.front();
-		vert = vStart;
+			// Folded straight back onto a? Then c goes too
+			if (closeTo(glm::distance(pos(c), pos(a)), 0))
+			{
+				if (bridge[c] || remaining <= 4)
+					break;
+				kept.pop_back();
+				inDir.pop_back();
+				remaining -= 2;
+				keepC = false;
+				break;
+			}
 
-		do
+			kept.pop_back();
+			inDir.pop_back();
+			remaining--;
+		}
+
+		if (keepC)
 		{
-			vertex_t* between = vert->edge->vert;
-			vertex_t* end = between->edge->vert;
+			inDir.push_back(kept.size() ? pos(c) - pos(kept.back()) : glm::vec3(0, 0, 0));
+			kept.push_back(c);
+		}
+	}
 
-			glm::vec3 edge1 = (*vert->vert) - (*between->vert);
-			glm::vec3 edge2 = (*between->vert) - (*end->vert);
-			glm::vec3 triNormal = glm::cross(edge1, edge2);
+	// Clean up the seam
+	size_t head = 0;
+	bool changed = true;
+	while (changed && remaining > 3)
+	{
+		changed = false;
+		int a = kept[kept.size() - 2], b = kept.back(), c = kept[head];
+		if (!bridge[a] && !bridge[b] && edgesCollinear(pos(b) - pos(a), pos(c) - pos(b)))
+		{
+			if (!closeTo(glm::distance(pos(c), pos(a)), 0))
+			{
+				kept.pop_back();
+				remaining--;
+				changed = true;
+			}
+			else if (!bridge[c] && remaining > 4)
+			{
+				kept.pop_back();
+				head++;
+				remaining -= 2;
+				changed = true;
+			}
+			continue;
+		}
 
-			if (triNormal.x == 0 && triNormal.y == 0 && triNormal.z == 0)
+		a = kept.back(), b = kept[head], c = kept[head + 1];
+		if (!bridge[a] && !bridge[b] && edgesCollinear(pos(b) - pos(a), pos(c) - pos(b)))
+		{
+			if (!closeTo(glm::distance(pos(c), pos(a)), 0))
 			{
-				fuseEdges(face, vert);
-				goto startOfLoop;
+				head++;
+				remaining--;
+				changed = true;
 			}
+			else if (!bridge[c] && remaining > 4)
+			{
+				head += 2;
+				remaining -= 2;
+				changed = true;
+			}
+		}
+	}
 
-			vert = between;
-		} while (vert->edge->vert != vStart);
+	if (remaining == count)
+		return;
+
+	// Relink what's left. Each kept vert's edge now runs all the way to the next kept vert
+	std::vector<bool> keep(count, false);
+	for (size_t i = head; i < kept.size(); i++)
+	{
+		int k = kept[i], next = kept[i + 1 < kept.size() ? i + 1 : head];
+		keep[k] = true;
+		loop[k]->edge->vert = loop[next];
+		loop[k]->edge->next = loop[next]->edge;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (keep[i])
+			continue;
+
+		halfEdge_t* e = loop[i]->edge;
+		if (e->pair && e->pair->pair == e)
+			e->pair->pair = nullptr;
+		delete e;
+		delete loop[i];
 	}
 
+	face->verts.clear();
+	face->edges.clear();
+	faceFromLoop(loop[kept[head]]->edge, face);
+}
+
+void optimizeParallelEdges(meshPart_t* part, std::vector<face_t*>& faceVec)
+{
+	for (auto face : faceVec)
+		if (face)
+			mergeCollinearEdges(face);
 }
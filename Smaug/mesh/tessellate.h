@@ -4,8 +4,28 @@
 
 face_t* sliceMeshPartFace(meshPart_t& mesh, std::vector<face_t*>& faceVec, face_t* face, vertex_t* start, vertex_t* end);
 
-void triangluateMeshPartFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec);
+// Triangulates a face into tris of its verts, wound the same way as the face. Cracks are treated as holes
+// Returns false if the face is too malformed to triangulate
+bool triangulateFace(face_t* face, glm::vec3 normal, std::vector<glm::vec3*>& outTris);
+
+// Triangulates every face within faceVec without modifying them. Works on concave and cracked faces
+// Tris are pushed onto outIndices as indices into the part's verts, followed by its cut verts
+void triangluateMeshPartFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec, std::vector<uint32_t>& outIndices);
+
+// Same as above, but only for convex faces
+void triangluateMeshPartConvexFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec, std::vector<uint32_t>& outIndices);
+// Slices convex faces into tris in place. Only use this when the tris' half edges are actually needed
 void triangluateMeshPartConvexFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec);
+
+// Splits a face into convex pieces with Hertel-Mehlhorn, leaving the face itself untouched. Cracks are treated as holes
+// Pieces are pushed onto outPieces. Returns false if the face couldn't be triangulated
+bool convexPartitionFace(meshPart_t& mesh, face_t* face, std::vector<face_t*>& outPieces);
+// Splits every face within faceVec into convex pieces in place, falling back on the greedy convexer for anything that can't be partitioned
 void convexifyMeshPartFaces(meshPart_t& mesh, std::vector<face_t*>& faceVec);
+// Greedily slices convex pieces off of each face. Makes more pieces than convexifyMeshPartFaces, but doesn't need to triangulate
+void convexifyMeshPartFacesGreedy(meshPart_t& mesh, std::vector<face_t*>& faceVec);
 
+// Merges runs of collinear edges around the face's loop in a single pass. Edges on cracks are left alone
+void mergeCollinearEdges(face_t* face);
+// Merges the collinear edges of every face within faceVec
 void optimizeParallelEdges(meshPart_t* part, std::vector<face_t*>& faceVec);
\ No newline at end of file
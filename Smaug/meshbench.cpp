@@ -0,0 +1,975 @@
+#include "meshbench.h"
+#include "worldeditor.h"
+#include "worldsave.h"
+#include "filesystem.h"
+#include "raytest.h"
+#include "slice.h"
+#include "tessellate.h"
+#include "meshtest.h"
+#include "log.h"
+
+#include <bgfx/bgfx.h>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+
+// Faces to chew on, and the part they came from
+struct benchPart_t
+{
+	meshPart_t* part;
+	std::vector<face_t*> faces;
+};
+
+struct benchSet_t
+{
+	std::string name;
+	std::vector<benchPart_t> parts;
+	size_t faces = 0;
+	size_t verts = 0;
+};
+
+// Everything we've made, so we can clean it up after
+static std::vector<cuttableMesh_t*> s_benchMeshes;
+
+static cuttableMesh_t* benchMesh()
+{
+	cuttableMesh_t* mesh = new cuttableMesh_t;
+	mesh->origin = { 0,0,0 };
+	s_benchMeshes.push_back(mesh);
+	return mesh;
+}
+
+// Gets a mesh ready for cutting, same as CNode::RebuildShape
+static void benchShape(cuttableMesh_t* mesh)
+{
+	recenterMesh(*mesh);
+	for (auto pa : mesh->parts)
+	{
+		defineMeshPartFaces(*pa);
+		optimizeParallelEdges(pa, pa->collision);
+		convexifyMeshPartFaces(*pa, pa->collision);
+	}
+}
+
+// Cuts every mesh by everything it touches, and gathers up the faces that come out of it
+static void benchCutInto(std::vector<cuttableMesh_t*>& meshes, benchSet_t& set)
+{
+	for (auto m : meshes)
+		benchShape(m);
+
+	std::vector<aabb_t> aabbs;
+	for (auto m : meshes)
+	{
+		aabb_t aabb = meshAABB(*m);
+		aabbs.push_back({ aabb.min + m->origin, aabb.max + m->origin });
+	}
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		std::vector<mesh_t*> cutters;
+		for (size_t j = 0; j < meshes.size(); j++)
+			if (i != j && testAABBOverlap(aabbs[i], aabbs[j], 0.01f))
+				cutters.push_back(meshes[j]);
+		applyCuts(meshes[i], cutters);
+	}
+
+	for (auto m : meshes)
+	{
+		for (auto pa : m->parts)
+		{
+			benchPart_t& bp = set.parts.emplace_back();
+			bp.part = pa;
+			if (pa->sliced)
+				bp.faces = pa->sliced->faces;
+			else
+				bp.faces.push_back(pa);
+
+			for (auto f : bp.faces)
+			{
+				set.faces++;
+				set.verts += f->verts.size();
+			}
+		}
+	}
+}
+
+// Flat single part mesh out of a loop of points on the xz plane
+static void benchLoop(benchSet_t& set, std::vector<glm::vec3>& points)
+{
+	cuttableMesh_t* mesh = benchMesh();
+	glm::vec3** p = addMeshVerts(*mesh, points.data(), points.size());
+	addMeshFace(*mesh, p, points.size());
+
+	std::vector<cuttableMesh_t*> meshes = { mesh };
+	benchCutInto(meshes, set);
+}
+
+static void benchBox(std::vector<cuttableMesh_t*>& meshes, glm::vec3 min, glm::vec3 max)
+{
+	glm::vec3 points[] = {
+		{min.x, min.y, min.z},
+		{max.x, min.y, min.z},
+		{max.x, max.y, min.z},
+		{min.x, max.y, min.z},
+		{min.x, min.y, max.z},
+		{max.x, min.y, max.z},
+		{max.x, max.y, max.z},
+		{min.x, max.y, max.z},
+	};
+
+	cuttableMesh_t* mesh = benchMesh();
+	auto p = addMeshVerts(*mesh, &points[0], 8);
+
+	// Same layout as CQuadNode
+	glm::vec3* faces[6][4] = {
+		{ p[7], p[6], p[5], p[4] },
+		{ p[0], p[1], p[2], p[3] },
+		{ p[3], p[7], p[4], p[0] },
+		{ p[2], p[1], p[5], p[6] },
+		{ p[4], p[5], p[1], p[0] },
+		{ p[3], p[2], p[6], p[7] },
+	};
+	for (auto& f : faces)
+		addMeshFace(*mesh, f, 4);
+
+	meshes.push_back(mesh);
+}
+
+// Every tooth is a split or merge for the sweep, and a pair of concave corners for the convexer
+static benchSet_t benchComb(int teeth)
+{
+	benchSet_t set;
+	set.name = "comb " + std::to_string(teeth);
+
+	std::vector<glm::vec3> points;
+	points.push_back({ 0, 0, 0 });
+	for (int i = 0; i < teeth; i++)
+	{
+		points.push_back({ i * 2.0f,        0, 4 });
+		points.push_back({ i * 2.0f + 1.0f, 0, 4 });
+		points.push_back({ i * 2.0f + 1.0f, 0, 1 });
+		points.push_back({ i * 2.0f + 2.0f, 0, 1 });
+	}
+	points.push_back({ teeth * 2.0f, 0, 0 });
+
+	benchLoop(set, points);
+	return set;
+}
+
+// Every other point is concave
+static benchSet_t benchStar(int points)
+{
+	benchSet_t set;
+	set.name = "star " + std::to_string(points);
+
+	std::vector<glm::vec3> loop;
+	for (int i = 0; i < points * 2; i++)
+	{
+		float angle = i * 3.14159265f / points;
+		float radius = i % 2 ? 32.0f : 64.0f;
+		loop.push_back({ cosf(angle) * radius, 0, sinf(angle) * radius });
+	}
+
+	benchLoop(set, loop);
+	return set;
+}
+
+// A slab with a grid of boxes sitting on it. The boxes crack holes into the top of the slab
+static benchSet_t benchCheese(int boxesPerSide)
+{
+	benchSet_t set;
+	set.name = "cheese " + std::to_string(boxesPerSide) + "x" + std::to_string(boxesPerSide);
+
+	std::vector<cuttableMesh_t*> meshes;
+	float size = boxesPerSide * 4.0f;
+	benchBox(meshes, { 0, -1, 0 }, { size, 0, size });
+	for (int x = 0; x < boxesPerSide; x++)
+		for (int z = 0; z < boxesPerSide; z++)
+			benchBox(meshes, { x * 4.0f + 1, 0, z * 4.0f + 1 }, { x * 4.0f + 3, 2, z * 4.0f + 3 });
+
+	benchCutInto(meshes, set);
+	return set;
+}
+
+// A square with every side chopped up into a run of collinear edges
+static benchSet_t benchSquare(int pointsPerSide)
+{
+	benchSet_t set;
+	set.name = "square " + std::to_string(pointsPerSide);
+
+	std::vector<glm::vec3> points;
+	glm::vec3 corners[] = { { 0, 0, 0 }, { 0, 0, 64 }, { 64, 0, 64 }, { 64, 0, 0 } };
+	for (int side = 0; side < 4; side++)
+		for (int i = 0; i < pointsPerSide; i++)
+			points.push_back(glm::mix(corners[side], corners[(side + 1) % 4], i / (float)pointsPerSide));
+
+	// Keep the run intact so the merge has something to chew on
+	cuttableMesh_t* mesh = benchMesh();
+	glm::vec3** p = addMeshVerts(*mesh, points.data(), points.size());
+	addMeshFace(*mesh, p, points.size());
+	recenterMesh(*mesh);
+
+	benchPart_t& bp = set.parts.emplace_back();
+	bp.part = mesh->parts.front();
+	bp.faces.push_back(bp.part);
+	set.faces = 1;
+	set.verts = points.size();
+	return set;
+}
+
+static bool benchWorld(const char* path, benchSet_t& set)
+{
+	size_t len;
+	char* str = filesystem::LoadFile(path, len);
+	if (!str)
+		return false;
+
+	std::vector<savedNode_t> savedNodes;
+	parseWorld(str, savedNodes);
+	free(str);
+
+	std::vector<cuttableMesh_t*> meshes;
+	for (auto& saved : savedNodes)
+	{
+		if (saved.parts.size() == 0 || saved.verts.size() == 0)
+			continue;
+
+		cuttableMesh_t* mesh = benchMesh();
+		mesh->origin = saved.origin;
+		glm::vec3** p = addMeshVerts(*mesh, saved.verts.data(), saved.verts.size());
+
+		for (auto& part : saved.parts)
+		{
+			std::vector<glm::vec3*> faceVerts;
+			for (auto v : part)
+				if (v >= 0 && (size_t)v < saved.verts.size())
+					faceVerts.push_back(p[v]);
+			addMeshFace(*mesh, faceVerts.data(), faceVerts.size());
+		}
+		meshes.push_back(mesh);
+	}
+
+	set.name = path;
+	benchCutInto(meshes, set);
+	return true;
+}
+
+// Set by any check that comes out wrong, so the whole run fails
+static bool s_benchFailed = false;
+
+// Notes down how a check came out. Returns what the row should say about it
+static const char* benchCheck(bool agree)
+{
+	if (!agree)
+		s_benchFailed = true;
+	return agree ? "agree" : "DISAGREE";
+}
+
+// Area of a face along normal. Crack bridges run both ways, so they cancel out
+static double benchFaceArea(face_t* face, glm::vec3 normal)
+{
+	glm::vec3 sum = { 0, 0, 0 };
+	for (auto v : face->verts)
+		sum += glm::cross(*v->vert, *v->edge->vert->vert);
+	return fabs(glm::dot(sum, normal)) / 2.0;
+}
+
+static double benchSetArea(benchSet_t& set)
+{
+	double area = 0;
+	for (auto& bp : set.parts)
+		for (auto face : bp.faces)
+			area += benchFaceArea(face, bp.part->normal);
+	return area;
+}
+
+// Whatever we split faces up into should still cover all of them, and nothing more
+static bool benchSameArea(double area, double expected)
+{
+	return fabs(area - expected) <= 0.001 * std::max(1.0, expected);
+}
+
+// Runs the job until we've got enough time in to trust the average. Returns milliseconds per run
+template<typename F>
+static double benchTime(F&& job)
+{
+	using clock = std::chrono::steady_clock;
+
+	int runs = 0;
+	double elapsed = 0;
+	clock::time_point start = clock::now();
+	do
+	{
+		job();
+		runs++;
+		elapsed = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	} while (elapsed < 250.0 && runs < 1000);
+
+	return elapsed / runs;
+}
+
+// Sweeps the faces straight into index lists
+static size_t benchMonotone(benchSet_t& set)
+{
+	std::vector<uint32_t> indices;
+	for (auto& bp : set.parts)
+		triangluateMeshPartFaces(*bp.part, bp.faces, indices);
+	return indices.size() / 3;
+}
+
+// How tris used to get made. Convexify each face, then slice the pieces into tri faces
+static size_t benchConvexFan(benchSet_t& set)
+{
+	size_t count = 0;
+	for (auto& bp : set.parts)
+	{
+		for (auto face : bp.faces)
+		{
+			face_t* f = new face_t;
+			cloneFaceInto(face, f);
+			f->parent = face;
+
+			std::vector<face_t*> temp = { f };
+			optimizeParallelEdges(bp.part, temp);
+			convexifyMeshPartFacesGreedy(*bp.part, temp);
+			triangluateMeshPartConvexFaces(*bp.part, temp);
+
+			count += temp.size();
+			for (auto t : temp)
+				delete t;
+		}
+	}
+	return count;
+}
+
+static void benchRun(benchSet_t& set)
+{
+	// Faces the sweep gives up on and hands off to the convexer
+	// The ones it does take should come out covering the same area
+	int fallbacks = 0;
+	double faceArea = 0, triArea = 0;
+	std::vector<glm::vec3*> tris;
+	for (auto& bp : set.parts)
+	{
+		glm::vec3 normal = bp.part->normal;
+		for (auto face : bp.faces)
+		{
+			tris.clear();
+			if (!triangulateFace(face, normal, tris))
+			{
+				fallbacks++;
+				continue;
+			}
+
+			faceArea += benchFaceArea(face, normal);
+			for (size_t i = 0; i + 2 < tris.size(); i += 3)
+				triArea += fabs(glm::dot(glm::cross(*tris[i + 1] - *tris[i], *tris[i + 2] - *tris[i]), normal)) / 2.0;
+		}
+	}
+
+	size_t monoTris = 0, fanTris = 0;
+	double monoMs = benchTime([&]() { monoTris = benchMonotone(set); });
+	double fanMs = benchTime([&]() { fanTris = benchConvexFan(set); });
+
+	Log::Msg("[MeshBench] %-24s %5zu faces %7zu verts | monotone %10.4f ms %7zu tris %3d fallbacks | convex fan %10.4f ms %7zu tris | %6.2fx | %s\n",
+		set.name.c_str(), set.faces, set.verts, monoMs, monoTris, fallbacks, fanMs, fanTris, fanMs / monoMs, benchCheck(benchSameArea(triArea, faceArea)));
+}
+
+// Hertel-Mehlhorn straight off of the faces. Anything it can't handle goes to the greedy convexer, same as convexifyMeshPartFaces
+// If area's passed in, the pieces' areas get added onto it
+static size_t benchPartition(benchSet_t& set, double* area = nullptr)
+{
+	size_t count = 0;
+	std::vector<face_t*> pieces;
+	for (auto& bp : set.parts)
+	{
+		for (auto face : bp.faces)
+		{
+			pieces.clear();
+			if (!convexPartitionFace(*bp.part, face, pieces))
+			{
+				face_t* f = new face_t;
+				cloneFaceInto(face, f);
+				pieces.push_back(f);
+				convexifyMeshPartFacesGreedy(*bp.part, pieces);
+			}
+
+			if (area)
+				for (auto p : pieces)
+					*area += benchFaceArea(p, bp.part->normal);
+
+			count += pieces.size();
+			for (auto p : pieces)
+				delete p;
+		}
+	}
+	return count;
+}
+
+// How collision used to get made
+static size_t benchGreedy(benchSet_t& set, double* area = nullptr)
+{
+	size_t count = 0;
+	std::vector<face_t*> pieces;
+	for (auto& bp : set.parts)
+	{
+		for (auto face : bp.faces)
+		{
+			face_t* f = new face_t;
+			cloneFaceInto(face, f);
+			pieces.clear();
+			pieces.push_back(f);
+			convexifyMeshPartFacesGreedy(*bp.part, pieces);
+
+			if (area)
+				for (auto p : pieces)
+					*area += benchFaceArea(p, bp.part->normal);
+
+			count += pieces.size();
+			for (auto p : pieces)
+				delete p;
+		}
+	}
+	return count;
+}
+
+static void benchPartitionRun(benchSet_t& set)
+{
+	size_t partitionPieces = 0, greedyPieces = 0;
+	double partitionMs = benchTime([&]() { partitionPieces = benchPartition(set); });
+	double greedyMs = benchTime([&]() { greedyPieces = benchGreedy(set); });
+
+	// Once more outside of the timing, to check the pieces
+	double faceArea = benchSetArea(set), partitionArea = 0, greedyArea = 0;
+	benchPartition(set, &partitionArea);
+	benchGreedy(set, &greedyArea);
+	bool agree = benchSameArea(partitionArea, faceArea) && benchSameArea(greedyArea, faceArea);
+
+	Log::Msg("[MeshBench] %-24s %5zu faces %7zu verts | partition %10.4f ms %6zu pieces | greedy %10.4f ms %6zu pieces | %6.2fx | %s\n",
+		set.name.c_str(), set.faces, set.verts, partitionMs, partitionPieces, greedyMs, greedyPieces, greedyMs / partitionMs, benchCheck(agree));
+}
+
+// Clones every face and merges it down. Returns how many verts are left
+// If area's passed in, the merged faces' areas get added onto it
+static size_t benchMerge(benchSet_t& set, std::vector<face_t*>& clones, bool merge, double* area = nullptr)
+{
+	size_t count = 0;
+	std::vector<glm::vec3> normals;
+	for (auto& bp : set.parts)
+	{
+		for (auto face : bp.faces)
+		{
+			face_t* f = new face_t;
+			cloneFaceInto(face, f);
+			clones.push_back(f);
+			if (area)
+				normals.push_back(bp.part->normal);
+		}
+	}
+
+	if (merge)
+		for (auto f : clones)
+			mergeCollinearEdges(f);
+
+	for (size_t i = 0; i < clones.size(); i++)
+	{
+		if (area)
+			*area += benchFaceArea(clones[i], normals[i]);
+		count += clones[i]->verts.size();
+		delete clones[i];
+	}
+	clones.clear();
+	return count;
+}
+
+static void benchMergeRun(benchSet_t& set)
+{
+	std::vector<face_t*> clones;
+	size_t verts = 0;
+	double cloneMs = benchTime([&]() { benchMerge(set, clones, false); });
+	double mergeMs = benchTime([&]() { verts = benchMerge(set, clones, true); });
+
+	// Merging only drops verts that sit in a straight line, so nothing should move
+	double mergedArea = 0;
+	benchMerge(set, clones, true, &mergedArea);
+
+	// Cloning isn't what we're here to time
+	double ms = std::max(mergeMs - cloneMs, 0.0);
+	Log::Msg("[MeshBench] %-24s %5zu faces %7zu verts | merge %10.4f ms %7zu verts left | %8.2f ns per vert | %s\n",
+		set.name.c_str(), set.faces, set.verts, ms, verts, ms * 1000000.0 / set.verts, benchCheck(benchSameArea(mergedArea, benchSetArea(set))));
+}
+
+// A field of boxes, picked at from above. The BVH against testing every node's AABB, one at a time and in batches
+static void benchPicking(int nodeCount)
+{
+	// Never registered with the world, but DeleteNode still cleans them up. They're never built, so bgfx never gets involved
+	std::vector<CNode*> nodes;
+	int side = ceilf(sqrtf(nodeCount));
+	for (int i = 0; i < nodeCount; i++)
+	{
+		CQuadNode* node = new CQuadNode();
+		node->m_mesh.origin = { (i % side) * 4.0f, (i % 7) * 0.5f, (i / side) * 4.0f };
+		nodes.push_back(node);
+
+		// Shaped up front, so the traces aren't timing that
+		GetWorldEditor().MaterialiseShape(node);
+	}
+
+	CWorldBVH bvh;
+	bvh.Build(nodes);
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> across(-8.0f, side * 4.0f + 8.0f);
+	std::uniform_real_distribution<float> tilt(-0.5f, 0.5f);
+	std::vector<ray_t> rays(1024);
+	for (auto& ray : rays)
+		ray = { { across(rng), 32.0f, across(rng) }, glm::normalize(glm::vec3(tilt(rng), -1.0f, tilt(rng))) };
+
+	std::vector<testRayPlane_t> bvhHits(rays.size()), linearHits(rays.size());
+	double bvhMs = benchTime([&]()
+	{
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			bvhHits[i] = { false };
+			bvh.TraceRay(rays[i], bvhHits[i], testNode);
+		}
+	});
+	double linearMs = benchTime([&]()
+	{
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			linearHits[i] = { false };
+			for (auto node : nodes)
+			{
+				testRayPlane_t aabbTest;
+				rayAABBTest(rays[i], node->GetAbsAABB(), aabbTest);
+				if (aabbTest.hit)
+					testNode(rays[i], node, linearHits[i]);
+			}
+		}
+	});
+
+	// Short lines. Bounded to the end of the line up front, against tracing the whole ray and checking the distance after
+	std::vector<line_t> lines(rays.size());
+	for (size_t i = 0; i < rays.size(); i++)
+		lines[i] = { rays[i].origin - rays[i].dir * (rays[i].origin.y - 4.0f), rays[i].dir * 3.0f };
+
+	std::vector<testRayPlane_t> boundedHits(lines.size()), unboundedHits(lines.size());
+	double boundedMs = benchTime([&]()
+	{
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			boundedHits[i] = { false };
+			boundedHits[i].t = 1.0f;
+			bvh.TraceRay({ lines[i].origin, lines[i].delta }, boundedHits[i], testNode);
+		}
+	});
+	double unboundedMs = benchTime([&]()
+	{
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			unboundedHits[i] = { false };
+			bvh.TraceRay({ lines[i].origin, lines[i].delta }, unboundedHits[i], testNode);
+			if (glm::distance(unboundedHits[i].intersect, lines[i].origin) > glm::length(lines[i].delta))
+				unboundedHits[i] = { false };
+		}
+	});
+
+	int lineAgree = 0;
+	for (size_t i = 0; i < lines.size(); i++)
+		if (boundedHits[i].hit == unboundedHits[i].hit && (!boundedHits[i].hit || boundedHits[i].t == unboundedHits[i].t))
+			lineAgree++;
+
+	// Same again, but with a whole batch of boxes tested at once
+	std::vector<aabbBatch_t> batches((nodes.size() + AABB_BATCH_SIZE - 1) / AABB_BATCH_SIZE);
+	for (size_t i = 0; i < nodes.size(); i++)
+		aabbBatchSet(batches[i / AABB_BATCH_SIZE], i % AABB_BATCH_SIZE, nodes[i]->GetAbsAABB());
+
+	std::vector<testRayPlane_t> batchHits(rays.size());
+	double batchMs = benchTime([&]()
+	{
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			batchHits[i] = { false };
+			glm::vec3 invDir = 1.0f / rays[i].dir;
+			for (size_t b = 0; b < batches.size(); b++)
+			{
+				float enter[AABB_BATCH_SIZE];
+				int hits = rayAABBBatchTest(batches[b], rays[i].origin, invDir, FLT_MAX, enter);
+				for (int j = 0; hits; j++, hits >>= 1)
+					if (hits & 1)
+						testNode(rays[i], nodes[b * AABB_BATCH_SIZE + j], batchHits[i]);
+			}
+		}
+	});
+
+	int agree = 0;
+	for (size_t i = 0; i < rays.size(); i++)
+		if (bvhHits[i].hit == linearHits[i].hit && (!bvhHits[i].hit || bvhHits[i].t == linearHits[i].t)
+			&& batchHits[i].hit == linearHits[i].hit && (!batchHits[i].hit || batchHits[i].t == linearHits[i].t))
+			agree++;
+
+	benchCheck(agree == (int)rays.size());
+	benchCheck(lineAgree == (int)lines.size());
+
+	double perRay = 1000.0 / rays.size();
+	Log::Msg("[MeshBench] %-24s %5d nodes | bvh %10.4f us per ray | linear %10.4f us per ray | batched %10.4f us per ray | %d/%zu rays agree\n",
+		"picking", nodeCount, bvhMs * perRay, linearMs * perRay, batchMs * perRay, agree, rays.size());
+	Log::Msg("[MeshBench] %-24s %5d nodes | bounded %10.4f us per line | unbounded %10.4f us per line | %6.2fx | %d/%zu lines agree\n",
+		"line picking", nodeCount, boundedMs * perRay, unboundedMs * perRay, unboundedMs / boundedMs, lineAgree, lines.size());
+
+	// Closest vert looking straight down, like drags snapping onto the world. Against checking every vert of every node
+	glm::vec3 downMask = { 1, 0, 1 };
+	float snapDistance = 2.0f;
+	auto closestVert = [&](CNode* node, glm::vec3 point, float& best)
+	{
+		float nodeDistance = FLT_MAX;
+		for (auto v : node->m_mesh.verts)
+		{
+			float distance = glm::length((node->Origin() + *v - point) * downMask);
+			nodeDistance = std::min(nodeDistance, distance);
+			best = std::min(best, distance);
+		}
+		return nodeDistance;
+	};
+
+	std::vector<float> bvhNearest(rays.size()), linearNearest(rays.size());
+	double nearestMs = benchTime([&]()
+	{
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			bvhNearest[i] = snapDistance;
+			bvh.FindNearest(rays[i].origin, downMask, snapDistance, [&](CNode* node) { return closestVert(node, rays[i].origin, bvhNearest[i]); });
+		}
+	});
+	double bruteMs = benchTime([&]()
+	{
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			linearNearest[i] = snapDistance;
+			for (auto node : nodes)
+				closestVert(node, rays[i].origin, linearNearest[i]);
+		}
+	});
+
+	int nearestAgree = 0;
+	for (size_t i = 0; i < rays.size(); i++)
+		if (bvhNearest[i] == linearNearest[i])
+			nearestAgree++;
+
+	benchCheck(nearestAgree == (int)rays.size());
+
+	Log::Msg("[MeshBench] %-24s %5d nodes | bvh %10.4f us per point | brute force %10.4f us per point | %6.2fx | %d/%zu points agree\n",
+		"nearest vert", nodeCount, nearestMs * perRay, bruteMs * perRay, bruteMs / nearestMs, nearestAgree, rays.size());
+
+	// A camera looking down on the whole field. Grouped into 4x4 tiles of pixels, so every packet stays together
+	int res = 256;
+	glm::vec3 eye = { side * 2.0f, side * 4.0f, side * 2.0f };
+	float spread = 0.5f;
+	std::vector<ray_t> view;
+	view.reserve(res * res);
+	for (int ty = 0; ty < res; ty += 4)
+		for (int tx = 0; tx < res; tx += 4)
+			for (int y = ty; y < ty + 4; y++)
+				for (int x = tx; x < tx + 4; x++)
+					view.push_back({ eye, glm::normalize(glm::vec3((x + 0.5f) / res * 2.0f - 1.0f, 0, (y + 0.5f) / res * 2.0f - 1.0f) * spread + glm::vec3(0, -1, 0)) });
+
+	std::vector<testRayPlane_t> singleHits(view.size()), packetHits(view.size());
+	double singleMs = benchTime([&]()
+	{
+		for (size_t i = 0; i < view.size(); i++)
+		{
+			singleHits[i] = { false };
+			bvh.TraceRay(view[i], singleHits[i], testNode);
+		}
+	});
+	double packetMs = benchTime([&]()
+	{
+		for (size_t i = 0; i < view.size(); i += RAY_PACKET_SIZE)
+		{
+			rayPacket_t packet;
+			for (int r = 0; r < RAY_PACKET_SIZE; r++)
+			{
+				rayPacketSet(packet, r, view[i + r]);
+				packetHits[i + r] = { false };
+			}
+			bvh.TracePacket(packet, &packetHits[i], testNodePacket);
+		}
+	});
+
+	agree = 0;
+	for (size_t i = 0; i < view.size(); i++)
+		if (singleHits[i].hit == packetHits[i].hit && (!singleHits[i].hit || singleHits[i].t == packetHits[i].t))
+			agree++;
+
+	benchCheck(agree == (int)view.size());
+
+	perRay = 1000.0 / view.size();
+	Log::Msg("[MeshBench] %-24s %5d nodes | single %10.4f us per ray | packets %10.4f us per ray | %6.2fx | %d/%zu rays agree\n",
+		"view picking", nodeCount, singleMs * perRay, packetMs * perRay, singleMs / packetMs, agree, view.size());
+
+	// Our BVH lets go of them first, so DeleteNode doesn't think they're in the world's
+	bvh.Clear();
+	for (auto node : nodes)
+		GetWorldEditor().DeleteNode(node);
+}
+
+// A circle's worth of edges, and a cloud of points over and around it. One point at a time against the whole batch
+static void benchPointInConvex(int edges)
+{
+	std::vector<glm::vec3> loop;
+	for (int i = 0; i < edges; i++)
+	{
+		float angle = -i * 6.2831853f / edges;
+		loop.push_back({ cosf(angle) * 32.0f, 0, sinf(angle) * 32.0f });
+	}
+
+	cuttableMesh_t* mesh = benchMesh();
+	glm::vec3** p = addMeshVerts(*mesh, loop.data(), loop.size());
+	addMeshFace(*mesh, p, loop.size());
+	meshPart_t* part = mesh->parts.back();
+	defineMeshPartFaces(*part);
+	vertex_t* start = part->verts.front();
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> across(-40.0f, 40.0f);
+	std::vector<glm::vec3> cloud(1024);
+	convexPoints_t points;
+	for (auto& c : cloud)
+	{
+		c = { across(rng), 0, across(rng) };
+		convexPointsAdd(points, c);
+	}
+
+	pointInConvexTest_t single;
+	double singleMs = benchTime([&]()
+	{
+		single = {};
+		for (auto& c : cloud)
+		{
+			pointInConvexTest_t t = pointInConvexLoopQueryIgnoreNonOuterEdges(start, c);
+			if (t.outside)
+				single.outside++;
+			else if (t.onEdge)
+				single.onEdge++;
+			else
+				single.inside++;
+		}
+	});
+
+	pointInConvexTest_t batch;
+	std::vector<uint8_t> flags(points.x.size());
+	convexLoopPlanes_t planes;
+	double batchMs = benchTime([&]()
+	{
+		convexLoopPlanes(start, planes, true);
+		batch = pointsInConvexLoopQuery(planes, points, flags.data());
+	});
+
+	bool agree = single.inside == batch.inside && single.outside == batch.outside && single.onEdge == batch.onEdge;
+	Log::Msg("[MeshBench] %-24s %5d edges %5zu points | single %10.4f ms | batch %10.4f ms | %6.2fx | %s\n",
+		"point in convex", edges, cloud.size(), singleMs, batchMs, singleMs / batchMs, benchCheck(agree));
+}
+
+// Stepped field of tiles, each its own part. Terrain-ish, but every tile stays flat so it's one collision face
+class CBenchTileNode : public CNode
+{
+public:
+	CBenchTileNode(int side)
+	{
+		for (int z = 0; z < side; z++)
+		{
+			for (int x = 0; x < side; x++)
+			{
+				float h = ((x * 7 + z * 13) % 5) * 0.25f;
+				float fx = (float)x, fz = (float)z;
+				glm::vec3 points[] = {
+					{ fx,     h, fz + 1 },
+					{ fx + 1, h, fz + 1 },
+					{ fx + 1, h, fz     },
+					{ fx,     h, fz     },
+				};
+				auto p = addMeshVerts(m_mesh, &points[0], 4);
+				addMeshFace(m_mesh, p, 4);
+			}
+		}
+		Init();
+	}
+
+	// Skips the dirty check so it can be timed over and over
+	void BuildCollisionBVH() { m_collisionBVH.Build(m_mesh); }
+};
+
+// One big node, picked at from above. Should only grow with the log of its face count
+static void benchNodePicking(int side)
+{
+	// Cleaned up through DeleteNode, same as benchPicking
+	CBenchTileNode* node = new CBenchTileNode(side);
+	node->m_mesh.origin = { 0,0,0 };
+
+	double buildMs = benchTime([&]() { node->BuildCollisionBVH(); });
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> across(0.0f, (float)side);
+	std::uniform_real_distribution<float> tilt(-0.25f, 0.25f);
+	std::vector<ray_t> rays(1024);
+	for (auto& ray : rays)
+		ray = { { across(rng), 8.0f, across(rng) }, glm::normalize(glm::vec3(tilt(rng), -1.0f, tilt(rng))) };
+
+	int hits = 0;
+	double rayMs = benchTime([&]()
+	{
+		hits = 0;
+		for (auto& ray : rays)
+		{
+			testRayPlane_t end = { false };
+			testNode(ray, node, end);
+			hits += end.hit;
+		}
+	});
+
+	Log::Msg("[MeshBench] %-24s %5zu faces | build %10.4f ms | %10.4f us per ray | %d/%zu rays hit\n",
+		"node picking", node->CollisionBVH().FaceCount(), buildMs, rayMs * 1000.0 / rays.size(), hits, rays.size());
+
+	GetWorldEditor().DeleteNode(node);
+}
+
+// A field of identical boxes built through the world editor, with every tenth one pushed into its neighbour so the pair gets cut
+// Then an instanced box gets deleted, and has to let go of its instance without handing bgfx anything it never made
+static void benchInstancing(int nodeCount)
+{
+	// Nodes and instances both hand bgfx buffers, so it has to be up. No window needed
+	bgfx::Init init;
+	init.type = bgfx::RendererType::Noop;
+	if (!bgfx::init(init))
+	{
+		Log::Msg("[MeshBench] Couldn't start bgfx, skipping instancing\n");
+		return;
+	}
+
+	CWorldEditor& world = GetWorldEditor();
+	world.Clear();
+
+	int side = ceilf(sqrtf(nodeCount));
+	for (int i = 0; i < nodeCount; i++)
+	{
+		CQuadNode* node = world.CreateQuad();
+		node->m_mesh.origin = { (i % side) * 4.0f + (i % 10 == 0 ? 2.0f : 0.0f), 0.0f, (i / side) * 4.0f };
+	}
+
+	// Buffers given back only really go once the frame's done
+	double buildMs = benchTime([&]()
+	{
+		world.RebuildAll();
+		bgfx::frame();
+	});
+
+	int instanced = 0;
+	CNode* victim = nullptr;
+	for (auto n : world.m_nodes)
+	{
+		if (!n->Instance())
+			continue;
+		instanced++;
+		if (!victim && n->Instance()->m_users > 1)
+			victim = n;
+	}
+
+	size_t instances = 0;
+	for (auto& shape : world.m_instances)
+		instances += shape.second.size();
+
+	// Everyone else sharing it should still have it, one user down
+	bool released = false;
+	if (victim)
+	{
+		CMeshInstance* shared = victim->Instance();
+		uint32_t users = shared->m_users;
+		world.DeleteNode(victim);
+		released = shared->m_users == users - 1;
+	}
+	benchCheck(released);
+
+	world.Clear();
+	bgfx::frame();
+	bgfx::shutdown();
+
+	Log::Msg("[MeshBench] %6d nodes | rebuild %10.4f ms | %6d instanced through %zu instances, %6d on their own | delete %s\n",
+		nodeCount, buildMs, instanced, instances, nodeCount - instanced, released ? "released" : "FAILED");
+}
+
+int runMeshBenchmarks(const char* worldPath)
+{
+	s_benchFailed = false;
+
+	std::vector<benchSet_t> sets;
+	for (int teeth : { 16, 64, 256, 1024 })
+		sets.push_back(benchComb(teeth));
+	for (int points : { 32, 128, 512, 2048 })
+		sets.push_back(benchStar(points));
+	for (int boxes : { 2, 4, 8 })
+		sets.push_back(benchCheese(boxes));
+
+	// Other flags can follow us, so only take real paths
+	if (worldPath && *worldPath != '-')
+	{
+		benchSet_t& world = sets.emplace_back();
+		if (!benchWorld(worldPath, world))
+			sets.pop_back();
+	}
+
+	Log::Msg("[MeshBench] Triangulation\n");
+	for (auto& set : sets)
+		benchRun(set);
+
+	Log::Msg("[MeshBench] Convex partition\n");
+	for (auto& set : sets)
+		benchPartitionRun(set);
+
+	// Runs of collinear edges on top of everything else
+	std::vector<benchSet_t> mergeSets;
+	for (int points : { 16, 256, 4096, 65536 })
+		mergeSets.push_back(benchSquare(points));
+
+	Log::Msg("[MeshBench] Collinear merge\n");
+	for (auto& set : mergeSets)
+		benchMergeRun(set);
+	for (auto& set : sets)
+		benchMergeRun(set);
+
+	Log::Msg("[MeshBench] Point in convex\n");
+	for (int edges : { 4, 16, 64, 256 })
+		benchPointInConvex(edges);
+
+	Log::Msg("[MeshBench] World picking\n");
+	for (int nodeCount : { 500, 5000, 20000 })
+		benchPicking(nodeCount);
+
+	Log::Msg("[MeshBench] Node picking\n");
+	for (int side : { 4, 16, 64, 256 })
+		benchNodePicking(side);
+
+	Log::Msg("[MeshBench] Instancing\n");
+	for (int nodeCount : { 100, 1000, 3000 })
+		benchInstancing(nodeCount);
+
+	for (auto m : s_benchMeshes)
+	{
+		for (auto v : m->cutVerts)
+			delete v;
+		delete m;
+	}
+	s_benchMeshes.clear();
+
+	// Anything that didn't agree fails the run, so scripts can catch it
+	if (s_benchFailed)
+	{
+		Log::Warn("[MeshBench] Some checks came out wrong!\n");
+		return 1;
+	}
+	return 0;
+}
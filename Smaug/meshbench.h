@@ -0,0 +1,5 @@
+#pragma once
+
+// Headless benchmarks for the mesh and world query code. Run with -meshbench, optionally followed by a .smf to pull real faces out of
+// Returns what the process should exit with
+int runMeshBenchmarks(const char* worldPath);
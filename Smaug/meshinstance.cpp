@@ -0,0 +1,93 @@
+#include "meshinstance.h"
+#include "modelmanager.h"
+
+#include <cstring>
+
+CMeshInstance::CMeshInstance(cuttableMesh_t& mesh, uint64_t hash) : m_hash(hash)
+{
+	m_partSizes.reserve(mesh.parts.size());
+	for (auto p : mesh.parts)
+	{
+		m_partSizes.push_back(p->verts.size());
+		for (auto v : p->verts)
+			m_verts.push_back(*v->vert);
+	}
+
+	m_renderData.RebuildRenderData(mesh);
+}
+
+bool CMeshInstance::Matches(mesh_t& mesh)
+{
+	if (mesh.parts.size() != m_partSizes.size())
+		return false;
+
+	size_t next = 0;
+	for (size_t i = 0; i < mesh.parts.size(); i++)
+	{
+		std::vector<vertex_t*>& verts = mesh.parts[i]->verts;
+		if (verts.size() != m_partSizes[i])
+			return false;
+
+		for (auto v : verts)
+			if (*v->vert != m_verts[next++])
+				return false;
+	}
+
+	return true;
+}
+
+void CMeshInstance::Render(glm::vec3 origin)
+{
+	CModelTransform t;
+	t.SetLocalOrigin(origin);
+	m_renderData.Render(t);
+}
+
+bool meshShapesMatch(mesh_t& a, mesh_t& b)
+{
+	if (a.parts.size() != b.parts.size())
+		return false;
+
+	for (size_t i = 0; i < a.parts.size(); i++)
+	{
+		std::vector<vertex_t*>& av = a.parts[i]->verts;
+		std::vector<vertex_t*>& bv = b.parts[i]->verts;
+		if (av.size() != bv.size())
+			return false;
+
+		for (size_t j = 0; j < av.size(); j++)
+			if (*av[j]->vert != *bv[j]->vert)
+				return false;
+	}
+
+	return true;
+}
+
+uint64_t meshShapeHash(mesh_t& mesh)
+{
+	// FNV-1a over the exact bits, so anything meshShapesMatch says matches hashes the same
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&](uint32_t word)
+	{
+		hash ^= word;
+		hash *= 1099511628211ull;
+	};
+
+	for (auto p : mesh.parts)
+	{
+		add(p->verts.size());
+		for (auto v : p->verts)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				// -0 and 0 match, so they have to hash the same too
+				float f = (*v->vert)[axis] + 0.0f;
+				uint32_t bits;
+				memcpy(&bits, &f, sizeof(bits));
+				add(bits);
+			}
+		}
+	}
+
+	return hash;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "mesh.h"
+#include "meshrenderer.h"
+
+#include <glm/vec3.hpp>
+#include <vector>
+
+// Render data shared by every uncut node shaped exactly the same, so repeated pillars, frames and stairs only get uploaded once
+// Keeps nothing of the mesh it was built off of but its flattened out verts, to check new nodes against
+// Instances bring their own origin
+class CMeshInstance
+{
+public:
+	// Mesh has to be tessellated already
+	CMeshInstance(cuttableMesh_t& mesh, uint64_t hash);
+
+	bool Matches(mesh_t& mesh);
+	uint64_t Hash() { return m_hash; }
+
+	// This does not bgfx::submit!!
+	void Render(glm::vec3 origin);
+
+	// Nodes drawing through us. Whoever drops this to 0 deletes us
+	uint32_t m_users = 0;
+
+private:
+	// Every part's verts, one part after the other
+	std::vector<glm::vec3> m_verts;
+	std::vector<uint32_t> m_partSizes;
+
+	CMeshRenderer m_renderData;
+	uint64_t m_hash;
+};
+
+// Same parts with the same verts, in the same order. Origins don't matter
+bool meshShapesMatch(mesh_t& a, mesh_t& b);
+
+// Hash of a mesh's local shape. Meshes that match always hash the same
+uint64_t meshShapeHash(mesh_t& mesh);
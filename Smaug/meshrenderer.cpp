@@ -27,22 +27,31 @@ static bgfx::VertexLayout MeshVertexLayout()
 }
 
 
-CMeshRenderer::CMeshRenderer(cuttableMesh_t& mesh) : m_mesh(mesh), m_indexCount(0), m_empty(false)
+CMeshRenderer::CMeshRenderer(cuttableMesh_t& mesh) : m_mesh(&mesh), m_indexCount(0), m_empty(false)
+{
+}
+
+CMeshRenderer::CMeshRenderer() : m_mesh(nullptr), m_indexCount(0), m_empty(true)
 {
 }
 
 CMeshRenderer::~CMeshRenderer()
 {
-	bgfx::destroy(m_vertexBuf);
-	bgfx::destroy(m_indexBuf);
+	// Dormant and instanced nodes never have buffers to give back
+	FreeRenderData();
 }
 
 void CMeshRenderer::RebuildRenderData()
+{
+	RebuildRenderData(*m_mesh);
+}
+
+void CMeshRenderer::RebuildRenderData(cuttableMesh_t& mesh)
 {
 	const bgfx::Memory* vertBuf = nullptr;
 	const bgfx::Memory* indexBuf = nullptr;
 
-	BuildRenderData(vertBuf, indexBuf);
+	BuildRenderData(mesh, vertBuf, indexBuf);
 
 	if (!vertBuf || !indexBuf)
 	{
@@ -59,10 +68,22 @@ void CMeshRenderer::RebuildRenderData()
 	else
 	{
 		m_vertexBuf = bgfx::createDynamicVertexBuffer(vertBuf, MeshVertexLayout(), BGFX_BUFFER_ALLOW_RESIZE);
-		m_indexBuf = bgfx::createDynamicIndexBuffer(indexBuf, BGFX_BUFFER_ALLOW_RESIZE);
+		m_indexBuf = bgfx::createDynamicIndexBuffer(indexBuf, BGFX_BUFFER_ALLOW_RESIZE | BGFX_BUFFER_INDEX32);
 	}
 }
 
+void CMeshRenderer::FreeRenderData()
+{
+	if (bgfx::isValid(m_vertexBuf))
+		bgfx::destroy(m_vertexBuf);
+	if (bgfx::isValid(m_indexBuf))
+		bgfx::destroy(m_indexBuf);
+	m_vertexBuf = BGFX_INVALID_HANDLE;
+	m_indexBuf = BGFX_INVALID_HANDLE;
+	m_indexCount = 0;
+	m_empty = true;
+}
+
 void CMeshRenderer::Render()
 {
 	CModelTransform t;
@@ -74,7 +95,8 @@ void CMeshRenderer::Render(CModelTransform trnsfm)
 	if (m_empty)
 		return;
 
-	trnsfm.SetLocalOrigin(trnsfm.GetLocalOrigin() + m_mesh.origin);
+	if (m_mesh)
+		trnsfm.SetLocalOrigin(trnsfm.GetLocalOrigin() + m_mesh->origin);
 	glm::mat4 mtx = trnsfm.Matrix();
 	
 	bgfx::setTransform(&mtx[0][0]);
@@ -84,29 +106,20 @@ void CMeshRenderer::Render(CModelTransform trnsfm)
 }
 
 
-void CMeshRenderer::BuildRenderData(const bgfx::Memory*& vertBuf, const bgfx::Memory*& indexBuf)
+void CMeshRenderer::BuildRenderData(cuttableMesh_t& mesh, const bgfx::Memory*& vertBuf, const bgfx::Memory*& indexBuf)
 {
 	// We can only render tris!
-	if (m_mesh.verts.size() < 3)
+	if (mesh.verts.size() < 3)
 		return;
 
 	int indexCount = 0;
 	int vertexCount = 0;
-	for (auto p : m_mesh.parts)
+	for (auto p : mesh.parts)
 	{
+		indexCount += p->tris.size();
+		vertexCount += p->verts.size();
 		if (p->sliced)
-		{
-			indexCount += p->tris.size() * 3; // 3 indexes per tri
-			vertexCount += p->verts.size() + p->sliced->cutVerts.size();
-		}
-		else
-		{
-			indexCount += p->tris.size() * 3; // 3 indexes per tri
-			vertexCount += p->verts.size();
-
-		}
-		
-
+			vertexCount += p->sliced->cutVerts.size();
 	}
 
 	//SASSERT(indexCount > 0);
@@ -116,16 +129,16 @@ void CMeshRenderer::BuildRenderData(const bgfx::Memory*& vertBuf, const bgfx::Me
 	// Allocate our buffers
 	// bgfx cleans these up for us
 	vertBuf = bgfx::alloc(MeshVertexLayout().getSize(vertexCount));
-	indexBuf = bgfx::alloc(indexCount * sizeof(uint16_t)); // Each face is a tri
+	indexBuf = bgfx::alloc(indexCount * sizeof(uint32_t));
 
-	uint16_t* idxData = (uint16_t*)indexBuf->data;
+	uint32_t* idxData = (uint32_t*)indexBuf->data;
 	rMeshVertex_t* vtxData = (rMeshVertex_t*)vertBuf->data;
 
 	int vOffset = 0;
 	int iOffset = 0;
 
 
-	for (auto p : m_mesh.parts)
+	for (auto p : mesh.parts)
 	{
 
 		glm::vec3 norm = p->normal;
@@ -135,7 +148,6 @@ void CMeshRenderer::BuildRenderData(const bgfx::Memory*& vertBuf, const bgfx::Me
 			vtxData[vOffset] = { *v->vert, norm };
 			vOffset++;
 		}
-		int cv = vOffset;
 		
 		if(p->sliced)
 			for (auto v : p->sliced->cutVerts)
@@ -144,65 +156,11 @@ void CMeshRenderer::BuildRenderData(const bgfx::Memory*& vertBuf, const bgfx::Me
 				vOffset++;
 			}
 
-
-		for (auto f : p->tris)
+		// Tris already index into our verts then our cut verts, same as we just laid them out
+		for (auto i : p->tris)
 		{
-			//SASSERT(f->verts.size() == 3);
-			if (f->verts.size() != 3)
-				continue;
-			/*
-			// If our verts are out of order, this will fail. Should we use the HE data to determine this?
-			halfEdge_t* he = f->edges[0];
-			do
-			{
-
-				uint16_t vert = he->vert->vert - vertData;
-				if (vert > m_part.verts.size())
-					printf("[MeshRenderer] Mesh refering to vert not in list!!\n");
-
-				idxData[offset] = vert;
-				offset++;
-				he = he->next;
-			} while (he != f->edges[0]);
-			*/
-			for (auto v : f->verts)
-			{
-				uint16_t vert = 0;
-				bool found = false;
-				for (int j = 0; j < p->verts.size(); j++)
-				{
-					if (p->verts[j]->vert == v->vert)
-					{
-						found = true;
-						vert = vs + j;
-						break;
-					}
-				}
-
-				if(!found)
-				{
-
-					if (p->sliced)
-						for (int j = 0; j < p->sliced->cutVerts.size(); j++)
-						{
-							if (p->sliced->cutVerts[j] == v->vert)
-							{
-								found = true;
-								vert = cv + j;
-								break;
-							}
-						}
-				}
-
-				if(!found)
-				{
-					Log::Fault("[MeshRenderer] Mesh refering to vert not in list!!\n");
-				}
-
-				idxData[iOffset] = vert;
-				iOffset++;
-			}
-
+			idxData[iOffset] = vs + i;
+			iOffset++;
 		}
 	}
 
@@ -9,19 +9,25 @@ class CMeshRenderer
 {
 public:
 	CMeshRenderer(cuttableMesh_t& mesh);
+	// Not tied to any mesh. Build it off of one with RebuildRenderData(mesh), and it's drawn wherever Render's transform puts it
+	CMeshRenderer();
 	~CMeshRenderer();
 
 	void RebuildRenderData();
+	// Builds off of mesh without holding onto it, for render data that outlives where it came from
+	void RebuildRenderData(cuttableMesh_t& mesh);
+	// Hands our buffers back to bgfx. Render draws nothing until they're rebuilt
+	void FreeRenderData();
 	
 	// This does not bgfx::submit!!
 	void Render();
 	void Render(CModelTransform trnsfm);
 	
-	cuttableMesh_t& Mesh() { return m_mesh; }
+	cuttableMesh_t* Mesh() { return m_mesh; }
 
 private:
-	cuttableMesh_t& m_mesh;
-	void BuildRenderData(const bgfx::Memory*& vertBuf, const bgfx::Memory*& indexBuf);
+	cuttableMesh_t* m_mesh;
+	void BuildRenderData(cuttableMesh_t& mesh, const bgfx::Memory*& vertBuf, const bgfx::Memory*& indexBuf);
 	
 	bgfx::DynamicVertexBufferHandle m_vertexBuf = BGFX_INVALID_HANDLE;
 	bgfx::DynamicIndexBufferHandle m_indexBuf = BGFX_INVALID_HANDLE;
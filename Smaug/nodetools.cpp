@@ -1,6 +1,9 @@
 #include "nodetools.h"
 #include "svarex.h"
 #include "settingsmenu.h"
+#include "smaugapp.h"
+#include "cursor.h"
+#include "debugdraw.h"
 
 
 BEGIN_SVAR_TABLE(CNodeToolsSettings)
@@ -8,6 +11,10 @@ BEGIN_SVAR_TABLE(CNodeToolsSettings)
 	DEFINE_TABLE_SVAR_INPUT(dragToolHold,	   GLFW_KEY_UNKNOWN,    false)
 	DEFINE_TABLE_SVAR_INPUT(extrudeToolToggle, GLFW_KEY_UNKNOWN,    false)
 	DEFINE_TABLE_SVAR_INPUT(extrudeToolHold,   GLFW_KEY_LEFT_SHIFT, false)
+	DEFINE_TABLE_SVAR_INPUT(selectToolToggle,  GLFW_KEY_B,          false)
+	DEFINE_TABLE_SVAR_INPUT(selectToolHold,    GLFW_KEY_UNKNOWN,    false)
+	DEFINE_TABLE_SVAR_INPUT(selectToolLasso,   GLFW_KEY_LEFT_ALT,   false)
+	DEFINE_TABLE_SVAR_INPUT(selectToolAdd,     GLFW_KEY_LEFT_CONTROL, false)
 END_SVAR_TABLE()
 
 static CNodeToolsSettings s_NodeToolsSettings;
@@ -19,3 +26,101 @@ input_t CDragTool::GetHoldInput() { return s_NodeToolsSettings.dragToolHold; }
 
 input_t CExtrudeTool::GetToggleInput() { return s_NodeToolsSettings.extrudeToolToggle; }
 input_t CExtrudeTool::GetHoldInput() { return s_NodeToolsSettings.extrudeToolHold; }
+
+
+input_t CSelectTool::GetToggleInput() { return s_NodeToolsSettings.selectToolToggle; }
+input_t CSelectTool::GetHoldInput() { return s_NodeToolsSettings.selectToolHold; }
+
+// How far the mouse has to move before the lasso gets another point
+#define SELECT_LASSO_SPACING 0.5f
+
+// Half the size of the box drawn around each selected vert
+#define SELECT_VERT_SIZE 0.25f
+
+void CSelectTool::Enable()
+{
+	CBaseSelectionTool::Enable();
+	m_inSelect = false;
+	m_region.clear();
+}
+
+void CSelectTool::Update(float dt, glm::vec3 mousePosSnapped, glm::vec3 mousePosRaw)
+{
+	GetCursor().SetPosition(mousePosRaw);
+
+	// Using glfw input until something is figured out about ImGui's overriding
+	bool mouseDown = glfwGetMouseButton(GetApp().GetWindow(), GLFW_MOUSE_BUTTON_1) == GLFW_PRESS;
+
+	if (!m_inSelect)
+	{
+		if (mouseDown)
+		{
+			m_inSelect = true;
+			m_lasso = Input().IsDown(s_NodeToolsSettings.selectToolLasso);
+			m_region.clear();
+			m_region.push_back(mousePosRaw);
+		}
+	}
+	else if (mouseDown)
+	{
+		if (!m_lasso)
+		{
+			// Boxes only care about where we started and where we are now
+			m_region.resize(1);
+			m_region.push_back(mousePosRaw);
+		}
+		else if (glm::distance(m_region.back(), mousePosRaw) > SELECT_LASSO_SPACING)
+			m_region.push_back(mousePosRaw);
+	}
+	else
+	{
+		// Let go. Time to select
+		m_inSelect = false;
+
+		CSelectionSet& selection = GetActionManager().m_selection;
+		if (!Input().IsDown(s_NodeToolsSettings.selectToolAdd))
+			selection.Clear();
+
+		// A lasso with two points would turn into a box
+		if (!m_lasso || m_region.size() > 2)
+			GetActionManager().FindInRegion(m_region, selection, GetSelectionType());
+		m_region.clear();
+	}
+
+	// Outline what we're drawing
+	if (m_inSelect && m_region.size() > 1)
+	{
+		glm::vec3 color = { 1.0f, 1.0f, 0.0f };
+		if (m_lasso)
+		{
+			for (size_t i = 0; i < m_region.size(); i++)
+				DebugDraw().Line(m_region[i], m_region[(i + 1) % m_region.size()], color, 0.5f, 0.01f);
+		}
+		else
+		{
+			// Slide the start over to the end along just one of the plane's axes to get the other two corners
+			glm::vec3 mask = GetCursor().GetWorkingAxisMask();
+			glm::vec3 side = mask.x != 0 ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+			glm::vec3 a = m_region[0];
+			glm::vec3 c = m_region[1];
+			glm::vec3 b = a + (c - a) * side;
+			glm::vec3 d = c - (c - a) * side;
+			DebugDraw().Line(a, b, color, 0.5f, 0.01f);
+			DebugDraw().Line(b, c, color, 0.5f, 0.01f);
+			DebugDraw().Line(c, d, color, 0.5f, 0.01f);
+			DebugDraw().Line(d, a, color, 0.5f, 0.01f);
+		}
+	}
+
+	// Show off what's selected
+	CSelectionSet& selection = GetActionManager().m_selection;
+	for (auto n : selection.Nodes())
+		if (n.IsValid())
+			DebugDraw().AABB(n->GetAbsAABB(), { 1.0f, 1.0f, 0.0f }, 0.5f, 0.01f);
+	for (auto p : selection.Parts())
+		if (p.IsValid())
+			DebugDraw().HEFace(p, { 0.0f, 1.0f, 1.0f }, 0.5f, 0.01f);
+	for (auto v : selection.Verts())
+		if (v.IsValid())
+			DebugDraw().AABB(*v->vert + parentMesh(v->edge->face)->origin, { glm::vec3(-SELECT_VERT_SIZE), glm::vec3(SELECT_VERT_SIZE) }, { 1.0f, 0.0f, 1.0f }, 0.5f, 0.01f);
+}
@@ -129,3 +129,33 @@ public:
 
 	CWallExtrudeAction* m_wallExtrudeAction;
 };
+
+
+// Drag out a box to select everything inside of it. Hold the lasso key to draw the outline freehand instead
+class CSelectTool : public CBaseSelectionTool
+{
+public:
+
+	virtual const char* GetName() { return "Select"; }
+	virtual const char* GetIconPath() { return "assets/select.png"; }
+	virtual const char* GetCursorPath() { return "assets/gizmo.obj"; }
+
+	// When this key is pressed, this tool becomes active
+	virtual input_t GetToggleInput();
+
+	// While this key is held, this tool is active
+	virtual input_t GetHoldInput();
+
+
+	// Everything that lands in the region goes in the selection. Actions can pick out what they need from it
+	virtual int GetSelectionType() { return ACT_SELECT_NODE | ACT_SELECT_SIDE | ACT_SELECT_VERT; }
+
+	virtual void Enable();
+	virtual void Update(float dt, glm::vec3 mousePosSnapped, glm::vec3 mousePosRaw);
+
+	bool m_inSelect;
+	bool m_lasso;
+
+	// Corner to corner for boxes, the whole outline for lassos
+	std::vector<glm::vec3> m_region;
+};
@@ -26,10 +26,12 @@ char* COBJExporter::Export(CWorldEditor* world)
 #endif
 	stream << " build compiled on " << __DATE__ << "\n";
 
+	// We need every node's tris
+	GetWorldEditor().MaterialiseAll();
+
 	stream << "\n# Vertexes\n";
-	for (auto p : GetWorldEditor().m_nodes)
+	for (auto node : GetWorldEditor().m_nodes)
 	{
-		CNode* node = p.second;
 
 		cuttableMesh_t& mesh = node->m_mesh;
 		glm::vec3 origin = mesh.origin;
@@ -55,9 +57,8 @@ char* COBJExporter::Export(CWorldEditor* world)
 	stream << "\n# Faces\n";
 	int partNormOffset = 1;
 
-	for (auto p : GetWorldEditor().m_nodes)
+	for (auto node : GetWorldEditor().m_nodes)
 	{
-		CNode* node = p.second;
 
 		cuttableMesh_t& mesh = node->m_mesh;
 		stream << "# Node " << node->NodeID() << "\n";
@@ -67,29 +68,25 @@ char* COBJExporter::Export(CWorldEditor* world)
 		for (auto p : mesh.parts)
 		{
 
-			for (auto f : p->tris)
+			for (size_t i = 0; i + 2 < p->tris.size(); i += 3)
 			{
-				// If we have < 3 verts, dump this bozo
-				if (f->verts.size() < 3)
-				{
-					continue;
-				}
-
 				stream << "f";
-				for (auto v : f->verts)
+				for (size_t j = i; j < i + 3; j++)
 				{
-					uint16_t vert = 0;
-					auto f = std::find(mesh.verts.begin(), mesh.verts.end(), v->vert);
+					glm::vec3* v = partTriVert(p, p->tris[j]);
+
+					uint32_t vert = 0;
+					auto f = std::find(mesh.verts.begin(), mesh.verts.end(), v);
 					if (f != mesh.verts.end())
 					{
-						vert = f - mesh.verts.begin();// v->vert - vertData;
+						vert = f - mesh.verts.begin();
 					}
 					else
 					{
-						f = std::find(mesh.cutVerts.begin(), mesh.cutVerts.end(), v->vert);
+						f = std::find(mesh.cutVerts.begin(), mesh.cutVerts.end(), v);
 						if (f != mesh.cutVerts.end())
 						{
-							vert = mesh.verts.size() + (f - mesh.cutVerts.begin());// v->vert - vertData;
+							vert = mesh.verts.size() + (f - mesh.cutVerts.begin());
 						}
 						else
 						{
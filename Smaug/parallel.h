@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Runs job(i) for every i in [0, count) spread across all of our cores
+// Blocks until every job is done. Jobs must not touch anything another job writes to!
+template<typename F>
+void parallelFor(size_t count, F&& job)
+{
+	size_t threadCount = std::thread::hardware_concurrency();
+	if (threadCount > count)
+		threadCount = count;
+
+	// Not worth spinning up threads for
+	if (threadCount <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			job(i);
+		return;
+	}
+
+	// Jobs are handed out one at a time, so slow jobs don't hold up a whole thread's worth of work
+	std::atomic<size_t> next = 0;
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < count; i = next++)
+			job(i);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (size_t i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+
+	// We can pull our own weight too
+	worker();
+
+	for (auto& t : threads)
+		t.join();
+}
@@ -3,6 +3,7 @@
 #include "basicdraw.h"
 #include "modelmanager.h"
 #include "meshtest.h"
+#include "simd.h"
 #include <glm/geometric.hpp>
 
 using namespace glm;
@@ -45,6 +46,13 @@ bool testAABBInAABB(aabb_t a, aabb_t b, float aabbBloat)
         ;
 }
 
+bool testAABBOverlap(aabb_t a, aabb_t b, float aabbBloat)
+{
+    return a.min.x - aabbBloat <= b.max.x && a.max.x + aabbBloat >= b.min.x
+        && a.min.y - aabbBloat <= b.max.y && a.max.y + aabbBloat >= b.min.y
+        && a.min.z - aabbBloat <= b.max.z && a.max.z + aabbBloat >= b.min.z;
+}
+
 
 
 
@@ -220,100 +228,301 @@ testRayPlane_t rayVertLoopTest(ray_t ray, vertex_t* vert, float closestT)
     return { false };
 }
 
-// This is terrible
 void rayAABBTest(ray_t ray, aabb_t aabb, testRayPlane_t& lastTest)
 {
-    vec3 min = aabb.min;
-    vec3 max = aabb.max;
-    
-    // 6 sides
-    // clockwise-side-out order
-    // max first and min second
-    // made from our aabb
+    // Slab test
+    glm::vec3 invDir = 1.0f / ray.dir;
+    glm::vec3 t0 = (aabb.min - ray.origin) * invDir;
+    glm::vec3 t1 = (aabb.max - ray.origin) * invDir;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+
+    // Whichever slab we get into last is the side we went in through
+    int axis = 0;
+    if (tNear.y > tNear[axis])
+        axis = 1;
+    if (tNear.z > tNear[axis])
+        axis = 2;
+
+    float enter = std::max(tNear[axis], 0.0f);
+    float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+
+    // the ! dumps NANs
+    if (!(enter <= exit) || !(enter <= lastTest.t))
+        return;
 
-    testRayPlane_t test;
-    tri_t plane;
-
-    plane = { max,                       vec3(max.x, max.y, min.z), vec3(min.x, max.y, min.z) }; // Top
-    test = rayPlaneTest<false>(ray, plane, lastTest.t);
-    if (test.hit && test.intersect.x >= plane[2].x && test.intersect.z >= plane[2].z && test.intersect.x <= plane[0].x && test.intersect.z <= plane[0].z)
-        lastTest = test;
-
-    plane = { vec3(max.x, min.y, max.z), vec3(min.x, min.y, max.z), min                       };  // Bottom
-    test = rayPlaneTest<false>(ray, plane, lastTest.t);
-    if (test.hit && test.intersect.x >= plane[2].x && test.intersect.z >= plane[2].z && test.intersect.x <= plane[0].x && test.intersect.z <= plane[0].z)
-        lastTest = test;
-
-    plane = { max,                       vec3(max.x, min.y, max.z), vec3(max.x, min.y, min.z) }; // Right
-    test = rayPlaneTest<false>(ray, plane, lastTest.t);
-    if (test.hit && test.intersect.z >= plane[2].z && test.intersect.y >= plane[2].y && test.intersect.z <= plane[0].z && test.intersect.y <= plane[0].y)
-        lastTest = test;
-
-    plane = { vec3(min.x, max.y, max.z), vec3(min.x, max.y, min.z), min                       }; // Left
-    test = rayPlaneTest<false>(ray, plane, lastTest.t);
-    if (test.hit && test.intersect.z >= plane[2].z && test.intersect.y >= plane[2].y && test.intersect.z <= plane[0].z && test.intersect.y <= plane[0].y)
-        lastTest = test;
-
-    plane = { max,                       vec3(min.x, max.y, max.z), vec3(min.x, min.y, max.z) }; // Front
-    test = rayPlaneTest<false>(ray, plane, lastTest.t);
-    if (test.hit && test.intersect.x >= plane[2].x && test.intersect.y >= plane[2].y && test.intersect.x <= plane[0].x && test.intersect.y <= plane[0].y)
-        lastTest = test;
-
-    plane = { vec3(max.x, max.y, min.z), vec3(max.x, min.y, min.z), min                       }; // Back
-    test = rayPlaneTest<false>(ray, plane, lastTest.t);
-    if (test.hit && test.intersect.x >= plane[2].x && test.intersect.y >= plane[2].y && test.intersect.x <= plane[0].x && test.intersect.y <= plane[0].y)
-        lastTest = test;
+    glm::vec3 normal = { 0, 0, 0 };
+    normal[axis] = ray.dir[axis] < 0.0f ? 1.0f : -1.0f;
 
+    lastTest.hit = true;
+    lastTest.t = enter;
+    lastTest.normal = normal;
+    lastTest.approach = glm::dot(ray.dir, normal);
+    lastTest.intersect = ray.origin + ray.dir * enter;
 }
 
-void testNode(ray_t ray, CNode* node, testRayPlane_t& end)
+void aabbBatchSet(aabbBatch_t& batch, int slot, aabb_t aabb)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        batch.min[i][slot] = aabb.min[i];
+        batch.max[i][slot] = aabb.max[i];
+    }
+    batch.count = std::max(batch.count, slot + 1);
+}
+
+int rayAABBBatchTest(const aabbBatch_t& batch, glm::vec3 origin, glm::vec3 invDir, float maxT, float enter[AABB_BATCH_SIZE])
+{
+    int mask = 0;
+    for (int g = 0; g < batch.count; g += SIMD_LANES)
+    {
+        lanes_t tNear = lanesSet(0.0f);
+        lanes_t tFar = lanesSet(maxT);
+        for (int i = 0; i < 3; i++)
+        {
+            lanes_t o = lanesSet(origin[i]);
+            lanes_t inv = lanesSet(invDir[i]);
+            lanes_t t0 = lanesMul(lanesSub(lanesLoad(&batch.min[i][g]), o), inv);
+            lanes_t t1 = lanesMul(lanesSub(lanesLoad(&batch.max[i][g]), o), inv);
+            tNear = lanesMax(tNear, lanesMin(t0, t1));
+            tFar = lanesMin(tFar, lanesMax(t0, t1));
+        }
+        lanesStore(&enter[g], tNear);
+        mask |= lanesBits(lanesLessEqual(tNear, tFar)) << g;
+    }
+
+    // Slots past count hold whatever was there before
+    return mask & ((1 << batch.count) - 1);
+}
+
+void rayPacketSet(rayPacket_t& packet, int slot, ray_t ray)
 {
-    testRayPlane_t aabbTest;
-    aabb_t aabb = node->GetAbsAABB();
+    glm::vec3 invDir = 1.0f / ray.dir;
+    for (int i = 0; i < 3; i++)
+    {
+        packet.origin[i][slot] = ray.origin[i];
+        packet.dir[i][slot] = ray.dir[i];
+        packet.invDir[i][slot] = invDir[i];
+    }
+    packet.count = std::max(packet.count, slot + 1);
+}
 
+// Bits of active that land within lane group g
+#define PACKET_GROUP_BITS(active, g) (((active) >> (g)) & ((1 << SIMD_LANES) - 1))
 
-    rayAABBTest(ray, aabb, aabbTest);
-    if (!aabbTest.hit)
+int rayPacketAABBTest(const rayPacket_t& packet, int active, const aabb_t& aabb, const float maxT[RAY_PACKET_SIZE], float enter[RAY_PACKET_SIZE])
+{
+    int mask = 0;
+    for (int g = 0; g < packet.count; g += SIMD_LANES)
+    {
+        if (!PACKET_GROUP_BITS(active, g))
+            continue;
+
+        lanes_t tNear = lanesSet(0.0f);
+        lanes_t tFar = lanesLoad(&maxT[g]);
+        for (int i = 0; i < 3; i++)
+        {
+            lanes_t o = lanesLoad(&packet.origin[i][g]);
+            lanes_t inv = lanesLoad(&packet.invDir[i][g]);
+            lanes_t t0 = lanesMul(lanesSub(lanesSet(aabb.min[i]), o), inv);
+            lanes_t t1 = lanesMul(lanesSub(lanesSet(aabb.max[i]), o), inv);
+            tNear = lanesMax(tNear, lanesMin(t0, t1));
+            tFar = lanesMin(tFar, lanesMax(t0, t1));
+        }
+        lanesStore(&enter[g], tNear);
+        mask |= lanesBits(lanesLessEqual(tNear, tFar)) << g;
+    }
+    return mask & active;
+}
+
+// rayVertLoopTest<true> on every ray in active at once, keeping whatever's closer in closest
+// Each edge only gets worked out the once for the whole packet
+static void rayPacketVertLoopTest(const rayPacket_t& packet, int active, vertex_t* vert, testRayPlane_t* closest)
+{
+    glm::vec3 normal = vertNextNormal(vert);
+    float d = glm::dot(*vert->vert, normal);
+
+    lanes_t nx = lanesSet(normal.x), ny = lanesSet(normal.y), nz = lanesSet(normal.z);
+    lanes_t zero = lanesSet(0.0f);
+
+    // Where each ray meets the plane, and if it's still in the running
+    const int groups = RAY_PACKET_SIZE / SIMD_LANES;
+    lanes_t px[groups], py[groups], pz[groups], t[groups], approach[groups], inside[groups];
+    float maxT[RAY_PACKET_SIZE];
+    for (int i = 0; i < packet.count; i++)
+        maxT[i] = closest[i].t;
+
+    int any = 0;
+    for (int g = 0, o = 0; o < packet.count; g++, o += SIMD_LANES)
+    {
+        inside[g] = zero;
+        if (!PACKET_GROUP_BITS(active, o))
+            continue;
+
+        lanes_t ox = lanesLoad(&packet.origin[0][o]), oy = lanesLoad(&packet.origin[1][o]), oz = lanesLoad(&packet.origin[2][o]);
+        lanes_t dx = lanesLoad(&packet.dir[0][o]), dy = lanesLoad(&packet.dir[1][o]), dz = lanesLoad(&packet.dir[2][o]);
+
+        approach[g] = lanesAdd(lanesAdd(lanesMul(dx, nx), lanesMul(dy, ny)), lanesMul(dz, nz));
+        lanes_t originDot = lanesAdd(lanesAdd(lanesMul(ox, nx), lanesMul(oy, ny)), lanesMul(oz, nz));
+        t[g] = lanesDiv(lanesSub(lanesSet(d), originDot), approach[g]);
+
+        // Facing the plane, in front of us, and closer than anything else. The comparisons dump NANs
+        inside[g] = lanesAnd(lanesAnd(lanesLess(approach[g], zero), lanesLessEqual(zero, t[g])), lanesLessEqual(t[g], lanesLoad(&maxT[o])));
+        any |= lanesBits(inside[g]) << o;
+
+        px[g] = lanesAdd(ox, lanesMul(dx, t[g]));
+        py[g] = lanesAdd(oy, lanesMul(dy, t[g]));
+        pz[g] = lanesAdd(oz, lanesMul(dz, t[g]));
+    }
+
+    // Same as pointInConvexLoop
+    vertex_t* v = vert;
+    while (any & active)
+    {
+        vertex_t* next = v->edge->vert;
+
+        glm::vec3 delta = *next->vert - *v->vert;
+        glm::vec3 perp = glm::cross(delta, normal);
+        lanes_t vx = lanesSet(v->vert->x), vy = lanesSet(v->vert->y), vz = lanesSet(v->vert->z);
+        lanes_t perpX = lanesSet(perp.x), perpY = lanesSet(perp.y), perpZ = lanesSet(perp.z);
+
+        any = 0;
+        for (int g = 0, o = 0; o < packet.count; g++, o += SIMD_LANES)
+        {
+            if (!lanesBits(inside[g]))
+                continue;
+
+            lanes_t m = lanesAdd(lanesAdd(lanesMul(lanesSub(px[g], vx), perpX), lanesMul(lanesSub(py[g], vy), perpY)), lanesMul(lanesSub(pz[g], vz), perpZ));
+            inside[g] = lanesAnd(inside[g], lanesLessEqual(m, zero));
+            any |= lanesBits(inside[g]) << o;
+        }
+
+        v = next;
+        if (v == vert)
+            break;
+    }
+
+    any &= active;
+    if (!any)
         return;
 
+    // Write out whoever made it
+    float tOut[SIMD_LANES], approachOut[SIMD_LANES], xOut[SIMD_LANES], yOut[SIMD_LANES], zOut[SIMD_LANES];
+    for (int g = 0, o = 0; o < packet.count; g++, o += SIMD_LANES)
+    {
+        int bits = PACKET_GROUP_BITS(any, o);
+        if (!bits)
+            continue;
+
+        lanesStore(tOut, t[g]);
+        lanesStore(approachOut, approach[g]);
+        lanesStore(xOut, px[g]);
+        lanesStore(yOut, py[g]);
+        lanesStore(zOut, pz[g]);
+        for (int l = 0; l < SIMD_LANES; l++)
+        {
+            if (!(bits & (1 << l)))
+                continue;
+
+            testRayPlane_t& test = closest[o + l];
+            test.hit = true;
+            test.t = tOut[l];
+            test.normal = normal;
+            test.approach = approachOut[l];
+            test.intersect = { xOut[l], yOut[l], zOut[l] };
+        }
+    }
+}
+
+static void testCollisionFace(ray_t ray, face_t* face, testRayPlane_t& end)
+{
+    testRayPlane_t rayTest = rayVertLoopTest<true>(ray, face->verts.front(), end.t);
+    if (rayTest.hit)
+        end = rayTest;
+}
+
+// The world BVH has already made sure we're within the node's AABB
+void testNode(ray_t ray, CNode* node, testRayPlane_t& end)
+{
     // Test mesh
     // Offset the ray to the node
     glm::vec3 origin = node->m_mesh.origin;
     ray.origin -= origin;
-    for (auto p : node->m_mesh.parts)
-        for (auto f : p->collision)
+
+    // Only the faces the ray actually passes by, nearest first
+    testRayPlane_t local = { false };
+    local.t = end.t;
+    node->CollisionBVH().TraceRay(ray, local, testCollisionFace);
+    if (local.hit)
+    {
+        local.intersect += origin;
+        end = local;
+    }
+}
+
+static void testCollisionFacePacket(const rayPacket_t& packet, int active, face_t* face, testRayPlane_t* closest)
+{
+    rayPacketVertLoopTest(packet, active, face->verts.front(), closest);
+}
+
+void testNodePacket(const rayPacket_t& packet, int active, CNode* node, testRayPlane_t* closest)
+{
+    // Offset the rays to the node
+    glm::vec3 origin = node->m_mesh.origin;
+    rayPacket_t local = packet;
+    for (int i = 0; i < 3; i++)
+        for (int r = 0; r < packet.count; r++)
+            local.origin[i][r] -= origin[i];
+
+    testRayPlane_t localHits[RAY_PACKET_SIZE];
+    for (int r = 0; r < packet.count; r++)
+        localHits[r].t = closest[r].t;
+
+    node->CollisionBVH().TracePacket(local, active, localHits, testCollisionFacePacket);
+
+    for (int r = 0; r < packet.count; r++)
+    {
+        if ((active & (1 << r)) && localHits[r].hit)
         {
-            testRayPlane_t rayTest = rayVertLoopTest<true>(ray, f->verts.front(), end.t);
-            if (rayTest.hit)
-            {
-                rayTest.intersect += origin;
-                end = rayTest;
-            }
+            localHits[r].intersect += origin;
+            closest[r] = localHits[r];
         }
-    
+    }
+}
+
+void testRayPacket(const ray_t* rays, int count, testRayPlane_t* results)
+{
+    for (int start = 0; start < count; start += RAY_PACKET_SIZE)
+    {
+        rayPacket_t packet;
+        int size = std::min(count - start, RAY_PACKET_SIZE);
+        for (int r = 0; r < size; r++)
+        {
+            rayPacketSet(packet, r, rays[start + r]);
+            results[start + r] = { false };
+        }
+
+        GetWorldEditor().m_bvh.TracePacket(packet, results + start, testNodePacket);
+    }
 }
 
 testRayPlane_t testRay(ray_t ray)
 {
     testRayPlane_t end = { false };
 
-    for (auto p : GetWorldEditor().m_nodes)
-    {
-        testNode(ray, p.second, end );
-    }
+    // Nearest nodes first, so anything behind the closest hit gets skipped
+    GetWorldEditor().m_bvh.TraceRay(ray, end, testNode);
     return end;
 }
 
-// TODO: Add distance based optimizations!
 testRayPlane_t testLine(line_t line)
 {
-    testRayPlane_t rpTest = testRay({ line.origin, line.delta });
-    if (glm::distance(rpTest.intersect, line.origin) > glm::length(line.delta))
-    {
-        // Too long!
-        return { false };
-    }
-    return rpTest;
+    // With delta as the direction, the end of the line sits at t 1
+    // Starting closest off there means any node or face past the end gets skipped without a look
+    testRayPlane_t end = { false };
+    end.t = 1.0f;
+    GetWorldEditor().m_bvh.TraceRay({ line.origin, line.delta }, end, testNode);
+    return end;
 }
 
 
@@ -497,22 +706,22 @@ bool testPointInTriEdges(glm::vec3 p, glm::vec3 tri0, glm::vec3 tri1, glm::vec3
 
 testRayPlane_t pointOnPartLocal(meshPart_t* part, glm::vec3 p)
 {
-    
-    for (auto f : part->collision)
-    {
-        if (f->verts.size() < 3)
-            continue;
+    if (part->outline.size() < 3)
+        return { false };
 
-        glm::vec3 norm = convexFaceNormal(f);
-        norm = glm::normalize(norm);
+    // Every piece of the part lies on its plane, so that's where p is going to land
+    float distance = glm::dot(part->normal, p) - part->planeDist;
+    glm::vec3 onPlane = p - part->normal * distance;
 
-        testRayPlane_t t = rayVertLoopTest<false>({ p, -norm }, f->verts.front(), FLT_MAX);
+    if (!pointInPartOutline(part, onPlane))
+        return { false };
 
-        if (t.hit)
-        {
-            return t;
-        }
-        
-    }
-    return { false };
+    // Same as casting from p straight back at the part
+    testRayPlane_t t;
+    t.hit = true;
+    t.t = distance;
+    t.normal = part->normal;
+    t.approach = -1.0f;
+    t.intersect = onPlane;
+    return t;
 }
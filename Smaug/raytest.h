@@ -1,6 +1,8 @@
 #pragma once
 #include <glm/vec3.hpp>
+#include <glm/common.hpp>
 #include <cfloat>
+#include <algorithm>
 #include "mesh.h"
 
 // Ray and line have the same structure, but have different purposes
@@ -72,8 +74,23 @@ struct tri_t
 // Test if a ray hits any geo in the world
 testRayPlane_t testRay(ray_t ray);
 // Test if a line hits any geo in the world before running out
+// t on the result is in units of the line's delta, so it's never past 1
 testRayPlane_t testLine(line_t line);
 
+// Traces a whole bunch of rays at once. Same as testRay on each, but coherent rays share their trip down the BVHs
+// results lines up with rays
+void testRayPacket(const ray_t* rays, int count, testRayPlane_t* results);
+
+class CNode;
+// Tests the ray against the node's collision, updating end if anything's closer
+void testNode(ray_t ray, CNode* node, testRayPlane_t& end);
+
+struct rayPacket_t;
+// testNode on every ray in active. closest lines up with the packet
+void testNodePacket(const rayPacket_t& packet, int active, CNode* node, testRayPlane_t* closest);
+// Updates lastTest if the ray goes into the box any closer. Starting inside the box hits it at t 0
+void rayAABBTest(ray_t ray, aabb_t aabb, testRayPlane_t& lastTest);
+
 /////////////////////
 // Local Geo Tests //
 /////////////////////
@@ -82,6 +99,84 @@ bool testPointInAABB(glm::vec3 point, aabb_t aabb);
 // sizes up the aabb by aabbBloat units before testing
 bool testPointInAABB(glm::vec3 point, aabb_t aabb, float aabbBloat);
 bool testAABBInAABB(aabb_t a, aabb_t b, float aabbBloat = 0.0f);
+// True if the boxes overlap or touch at all
+bool testAABBOverlap(aabb_t a, aabb_t b, float aabbBloat = 0.0f);
+
+// Smallest box holding both
+inline aabb_t aabbUnion(const aabb_t& a, const aabb_t& b)
+{
+	return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+// Half the surface area. Only ever compared against other areas, so the half doesn't matter
+inline float aabbArea(const aabb_t& a)
+{
+	glm::vec3 d = glm::max(a.max - a.min, glm::vec3(0, 0, 0));
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+// Squared distance from point to the nearest spot on the box, on just the axes left in axisMask. 0 if it's inside
+inline float aabbDistanceSq(const aabb_t& a, glm::vec3 point, glm::vec3 axisMask = { 1, 1, 1 })
+{
+	glm::vec3 d = glm::max(glm::max(a.min - point, point - a.max), glm::vec3(0, 0, 0)) * axisMask;
+	return d.x * d.x + d.y * d.y + d.z * d.z;
+}
+
+// Where the ray enters the box, if it enters it before maxT. invDir is 1 / ray.dir
+inline bool rayAABBSlab(const aabb_t& aabb, glm::vec3 origin, glm::vec3 invDir, float maxT, float& enter)
+{
+	glm::vec3 t0 = (aabb.min - origin) * invDir;
+	glm::vec3 t1 = (aabb.max - origin) * invDir;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+
+	enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+	return enter <= exit && enter <= maxT;
+}
+
+// How many boxes rayAABBBatchTest takes on at once. As wide as the widest SIMD we were built with
+#if defined(__AVX__)
+#define AABB_BATCH_SIZE 8
+#else
+#define AABB_BATCH_SIZE 4
+#endif
+
+// A handful of boxes laid out a component at a time, so one ray can be slab tested against all of them at once
+struct alignas(32) aabbBatch_t
+{
+	float min[3][AABB_BATCH_SIZE] = {};
+	float max[3][AABB_BATCH_SIZE] = {};
+
+	// Slots past this are ignored
+	int count = 0;
+};
+
+// Sets the box at slot, growing count to fit it
+void aabbBatchSet(aabbBatch_t& batch, int slot, aabb_t aabb);
+
+// rayAABBSlab on every box in the batch. Returns a bit per box the ray enters before maxT, and fills enter with where
+int rayAABBBatchTest(const aabbBatch_t& batch, glm::vec3 origin, glm::vec3 invDir, float maxT, float enter[AABB_BATCH_SIZE]);
+
+// Most rays a packet can hold. Bigger jobs get split up into several packets
+#define RAY_PACKET_SIZE 16
+
+// Rays laid out a component at a time, so a box or a face can be tested against all of them at once
+struct rayPacket_t
+{
+	float origin[3][RAY_PACKET_SIZE] = {};
+	float dir[3][RAY_PACKET_SIZE] = {};
+	float invDir[3][RAY_PACKET_SIZE] = {};
+
+	// Slots past this are ignored
+	int count = 0;
+};
+
+// Sets the ray at slot, growing count to fit it
+void rayPacketSet(rayPacket_t& packet, int slot, ray_t ray);
+
+// rayAABBSlab on every ray in active, each with its own maxT. Returns a bit per ray that enters the box, and fills enter with where
+int rayPacketAABBTest(const rayPacket_t& packet, int active, const aabb_t& aabb, const float maxT[RAY_PACKET_SIZE], float enter[RAY_PACKET_SIZE]);
 
 testLineLine_t testLineLine(line_t a, line_t b, float tolerance = 0.01f);
 inline testLineLine_t testLineLine(halfEdge_t* a, halfEdge_t* b, glm::vec3 aOrigin, glm::vec3 bOrigin, float tolerance = 0.01f)
@@ -93,6 +188,7 @@ inline testLineLine_t testLineLine(halfEdge_t* a, halfEdge_t* b, glm::vec3 aOrig
 }
 
 
+// Projects p onto part, local to its mesh. Uses the part's precomputed plane and outline
 testRayPlane_t pointOnPartLocal(meshPart_t* part, glm::vec3 p);
 
 // Wish this could be a template...
@@ -31,8 +31,10 @@ void CSelectedView::Draw(float dt)
 		glm::mat4 view = glm::lookAt(glm::vec3(cos(time) * -distance, distance, sin(time) * distance) + origin, origin, glm::vec3(0.0f, 1.0f, 0.0f));
 		glm::mat4 proj = glm::perspective(glm::radians(60.0f), m_aspectRatio, 0.1f, 800.0f);
 		bgfx::setViewTransform(m_viewId, &view[0][0], &proj[0][0]);
-		
-		m_selectedNode->m_renderData.Render();
+
+		std::vector<CNode*> nodes = { m_selectedNode.Node() };
+		GetWorldEditor().Materialise(nodes);
+		m_selectedNode->Render();
 
 		// Set the color
 		// Precompute this?
@@ -99,7 +101,11 @@ bool CSelectedView::Show()
 			{
 				m_selectedNode->SetVisible(vis);
 			}
-			ImGui::DragFloat3("Origin", reinterpret_cast<float*>(&m_selectedNode->m_mesh.origin));
+			if (ImGui::DragFloat3("Origin", reinterpret_cast<float*>(&m_selectedNode->m_mesh.origin)))
+			{
+				// Moved out from under the BVH and sweep, and might be cutting something else now
+				m_selectedNode->PreviewUpdate();
+			}
 
 		}
 	}
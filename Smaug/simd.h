@@ -0,0 +1,82 @@
+#pragma once
+
+// Just enough of a wrapper around SSE and AVX to write a loop once and run it as wide as we were built for
+// Without either, it's one float at a time and the compiler is on its own
+
+#if defined(__AVX__)
+#include <immintrin.h>
+
+#define SIMD_LANES 8
+typedef __m256 lanes_t;
+
+inline lanes_t lanesSet(float f) { return _mm256_set1_ps(f); }
+inline lanes_t lanesLoad(const float* f) { return _mm256_loadu_ps(f); }
+inline void lanesStore(float* f, lanes_t a) { _mm256_storeu_ps(f, a); }
+inline lanes_t lanesAdd(lanes_t a, lanes_t b) { return _mm256_add_ps(a, b); }
+inline lanes_t lanesSub(lanes_t a, lanes_t b) { return _mm256_sub_ps(a, b); }
+inline lanes_t lanesMul(lanes_t a, lanes_t b) { return _mm256_mul_ps(a, b); }
+inline lanes_t lanesDiv(lanes_t a, lanes_t b) { return _mm256_div_ps(a, b); }
+inline lanes_t lanesMin(lanes_t a, lanes_t b) { return _mm256_min_ps(a, b); }
+inline lanes_t lanesMax(lanes_t a, lanes_t b) { return _mm256_max_ps(a, b); }
+
+// Comparisons come out as masks. Anything against a NAN is false
+inline lanes_t lanesLess(lanes_t a, lanes_t b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline lanes_t lanesLessEqual(lanes_t a, lanes_t b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+inline lanes_t lanesAnd(lanes_t a, lanes_t b) { return _mm256_and_ps(a, b); }
+inline lanes_t lanesOr(lanes_t a, lanes_t b) { return _mm256_or_ps(a, b); }
+inline lanes_t lanesNot(lanes_t a) { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+
+// A bit per lane that's set in the mask
+inline int lanesBits(lanes_t mask) { return _mm256_movemask_ps(mask); }
+
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <immintrin.h>
+
+#define SIMD_LANES 4
+typedef __m128 lanes_t;
+
+inline lanes_t lanesSet(float f) { return _mm_set1_ps(f); }
+inline lanes_t lanesLoad(const float* f) { return _mm_loadu_ps(f); }
+inline void lanesStore(float* f, lanes_t a) { _mm_storeu_ps(f, a); }
+inline lanes_t lanesAdd(lanes_t a, lanes_t b) { return _mm_add_ps(a, b); }
+inline lanes_t lanesSub(lanes_t a, lanes_t b) { return _mm_sub_ps(a, b); }
+inline lanes_t lanesMul(lanes_t a, lanes_t b) { return _mm_mul_ps(a, b); }
+inline lanes_t lanesDiv(lanes_t a, lanes_t b) { return _mm_div_ps(a, b); }
+inline lanes_t lanesMin(lanes_t a, lanes_t b) { return _mm_min_ps(a, b); }
+inline lanes_t lanesMax(lanes_t a, lanes_t b) { return _mm_max_ps(a, b); }
+
+inline lanes_t lanesLess(lanes_t a, lanes_t b) { return _mm_cmplt_ps(a, b); }
+inline lanes_t lanesLessEqual(lanes_t a, lanes_t b) { return _mm_cmple_ps(a, b); }
+inline lanes_t lanesAnd(lanes_t a, lanes_t b) { return _mm_and_ps(a, b); }
+inline lanes_t lanesOr(lanes_t a, lanes_t b) { return _mm_or_ps(a, b); }
+inline lanes_t lanesNot(lanes_t a) { return _mm_xor_ps(a, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+
+inline int lanesBits(lanes_t mask) { return _mm_movemask_ps(mask); }
+
+#else
+
+#define SIMD_LANES 1
+typedef float lanes_t;
+
+inline lanes_t lanesSet(float f) { return f; }
+inline lanes_t lanesLoad(const float* f) { return *f; }
+inline void lanesStore(float* f, lanes_t a) { *f = a; }
+inline lanes_t lanesAdd(lanes_t a, lanes_t b) { return a + b; }
+inline lanes_t lanesSub(lanes_t a, lanes_t b) { return a - b; }
+inline lanes_t lanesMul(lanes_t a, lanes_t b) { return a * b; }
+inline lanes_t lanesDiv(lanes_t a, lanes_t b) { return a / b; }
+
+// Picks b on NANs, same as SSE
+inline lanes_t lanesMin(lanes_t a, lanes_t b) { return a < b ? a : b; }
+inline lanes_t lanesMax(lanes_t a, lanes_t b) { return a > b ? a : b; }
+
+// Masks are just 1 or 0
+inline lanes_t lanesLess(lanes_t a, lanes_t b) { return a < b ? 1.0f : 0.0f; }
+inline lanes_t lanesLessEqual(lanes_t a, lanes_t b) { return a <= b ? 1.0f : 0.0f; }
+inline lanes_t lanesAnd(lanes_t a, lanes_t b) { return a * b; }
+inline lanes_t lanesOr(lanes_t a, lanes_t b) { return a + b > 0.0f ? 1.0f : 0.0f; }
+inline lanes_t lanesNot(lanes_t a) { return 1.0f - a; }
+
+inline int lanesBits(lanes_t mask) { return mask != 0.0f; }
+
+#endif
@@ -0,0 +1,187 @@
+#include "sweepprune.h"
+#include "worldeditor.h"
+
+#include <algorithm>
+
+// Grown by half the bloat on every side, so two boxes overlap once they're within the whole bloat of eachother
+static aabb_t sweepBox(CNode* node)
+{
+	aabb_t box = node->GetAbsAABB();
+	box.min -= NODE_TOUCH_BLOAT * 0.5f;
+	box.max += NODE_TOUCH_BLOAT * 0.5f;
+	return box;
+}
+
+void CSweepPrune::Clear()
+{
+	for (int axis = 0; axis < 3; axis++)
+		m_axes[axis].clear();
+}
+
+void CSweepPrune::Build(std::vector<CNode*>& nodes)
+{
+	Clear();
+
+	for (auto n : nodes)
+	{
+		// Nothing from before is trustworthy
+		n->m_cutters.clear();
+		n->m_cutting.clear();
+
+		n->m_sweepBox = sweepBox(n);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			m_axes[axis].push_back({ n->m_sweepBox.min[axis], n, false });
+			m_axes[axis].push_back({ n->m_sweepBox.max[axis], n, true });
+		}
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+		std::sort(m_axes[axis].begin(), m_axes[axis].end(), Before);
+
+	// Sweep across x. Everything we've seen start but not end yet overlaps us along it
+	std::vector<CNode*> open;
+	for (auto& e : m_axes[0])
+	{
+		if (e.max)
+		{
+			open.erase(std::find(open.begin(), open.end(), e.node));
+			continue;
+		}
+
+		for (auto o : open)
+			if (testAABBOverlap(e.node->m_sweepBox, o->m_sweepBox))
+				e.node->ConnectTo(o);
+		open.push_back(e.node);
+	}
+}
+
+void CSweepPrune::Insert(CNode* node, CWorldBVH& bvh)
+{
+	node->m_sweepBox = sweepBox(node);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		std::vector<endpoint_t>& ends = m_axes[axis];
+		endpoint_t min = { node->m_sweepBox.min[axis], node, false };
+		endpoint_t max = { node->m_sweepBox.max[axis], node, true };
+		ends.insert(std::upper_bound(ends.begin(), ends.end(), min, Before), min);
+		ends.insert(std::upper_bound(ends.begin(), ends.end(), max, Before), max);
+	}
+
+	// The BVH holds plain AABBs, so grow ours by the whole bloat to catch everything within it
+	aabb_t query = node->GetAbsAABB();
+	query.min -= NODE_TOUCH_BLOAT;
+	query.max += NODE_TOUCH_BLOAT;
+	bvh.FindInBox(query, { 1, 1, 1 }, [&](CNode* other)
+	{
+		if (other != node && testAABBOverlap(node->m_sweepBox, other->m_sweepBox))
+			node->ConnectTo(other);
+	});
+}
+
+void CSweepPrune::Remove(CNode* node)
+{
+	// Copied, since disconnecting changes it
+	std::vector<CNodeRef> touching(node->m_cutting.begin(), node->m_cutting.end());
+	for (auto& t : touching)
+		node->DisconnectFrom(t);
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		std::vector<endpoint_t>& ends = m_axes[axis];
+		ends.erase(ends.begin() + Find(axis, node, true));
+		ends.erase(ends.begin() + Find(axis, node, false));
+	}
+}
+
+void CSweepPrune::Update(CNode* node)
+{
+	// Have to find our ends by where they were before we change it
+	size_t index[3][2];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		index[axis][0] = Find(axis, node, false);
+		index[axis][1] = Find(axis, node, true);
+	}
+
+	aabb_t old = node->m_sweepBox;
+	node->m_sweepBox = sweepBox(node);
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		std::vector<endpoint_t>& ends = m_axes[axis];
+		ends[index[axis][0]].value = node->m_sweepBox.min[axis];
+		ends[index[axis][1]].value = node->m_sweepBox.max[axis];
+
+		// Everything but the end being sifted has to be in order, and the two ends can get in eachother's way
+		// Whichever end is heading away from the other goes first, so the second never has to get past the first
+		int first = 1, second = 0;
+		if (node->m_sweepBox.max[axis] <= old.max[axis])
+			std::swap(first, second);
+
+		size_t from = index[axis][first];
+		size_t to = Sift(axis, from);
+
+		// The first end moving past the second bumps it over by one
+		size_t other = index[axis][second];
+		if (from < other && other <= to)
+			other--;
+		else if (to <= other && other < from)
+			other++;
+		Sift(axis, other);
+	}
+}
+
+size_t CSweepPrune::Find(int axis, CNode* node, bool max)
+{
+	std::vector<endpoint_t>& ends = m_axes[axis];
+	endpoint_t key = { max ? node->m_sweepBox.max[axis] : node->m_sweepBox.min[axis], node, max };
+
+	// Anything else sitting at the exact same value could be in front of us
+	for (auto it = std::lower_bound(ends.begin(), ends.end(), key, Before); it != ends.end(); it++)
+		if (it->node == node && it->max == max)
+			return it - ends.begin();
+
+	SASSERT(false);
+	return 0;
+}
+
+size_t CSweepPrune::Sift(int axis, size_t index)
+{
+	std::vector<endpoint_t>& ends = m_axes[axis];
+	endpoint_t e = ends[index];
+
+	while (index > 0 && Before(e, ends[index - 1]))
+	{
+		Passed(e, ends[index - 1], true);
+		ends[index] = ends[index - 1];
+		index--;
+	}
+
+	while (index + 1 < ends.size() && Before(ends[index + 1], e))
+	{
+		Passed(e, ends[index + 1], false);
+		ends[index] = ends[index + 1];
+		index++;
+	}
+
+	ends[index] = e;
+	return index;
+}
+
+void CSweepPrune::Passed(const endpoint_t& e, const endpoint_t& f, bool left)
+{
+	if (e.node == f.node || e.max == f.max)
+		return;
+
+	// A min moving left past a max, or a max moving right past a min, means we just started overlapping along this axis
+	// We might still be apart along the others
+	bool start = left ? !e.max : e.max;
+	if (start)
+	{
+		if (testAABBOverlap(e.node->m_sweepBox, f.node->m_sweepBox))
+			e.node->ConnectTo(f.node);
+	}
+	else if (e.node->m_cutting.contains(f.node))
+		e.node->DisconnectFrom(f.node);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "raytest.h"
+
+#include <vector>
+
+class CNode;
+class CWorldBVH;
+
+// Parts have to be within this to cut eachother
+#define NODE_TOUCH_BLOAT 0.01f
+
+// Sweep and prune over the AABBs of every node in the world, kept sorted along all three axes
+// As nodes move, their ends shuffle over to where they belong. Whenever two nodes start or stop touching along the way, they get connected or disconnected
+// That keeps every node's m_cutters and m_cutting holding exactly what touches it
+class CSweepPrune
+{
+public:
+	void Clear();
+
+	// Throws everything out and sorts nodes in from scratch, connecting up everything that touches
+	// Much faster than inserting them one at a time
+	void Build(std::vector<CNode*>& nodes);
+
+	// Finds what the node touches through the BVH, so there's no sweeping across the whole world to place it
+	// The node should already be in the BVH
+	void Insert(CNode* node, CWorldBVH& bvh);
+	void Remove(CNode* node);
+
+	// Call after a node's AABB or origin changes
+	void Update(CNode* node);
+
+private:
+	struct endpoint_t
+	{
+		float value;
+		CNode* node;
+		bool max;
+	};
+
+	// Mins go before maxes at the same value, so boxes that only just touch count as touching
+	static bool Before(const endpoint_t& a, const endpoint_t& b) { return a.value < b.value || (a.value == b.value && !a.max && b.max); }
+
+	// Where one of node's ends sits on an axis right now
+	size_t Find(int axis, CNode* node, bool max);
+
+	// Moves the end at index along until it's back in order, handling everything it passes. Returns where it ended up
+	size_t Sift(int axis, size_t index);
+
+	// e just moved across f
+	void Passed(const endpoint_t& e, const endpoint_t& f, bool left);
+
+	std::vector<endpoint_t> m_axes[3];
+};
@@ -36,6 +36,7 @@ void CUIView::Init(bgfx::ViewId viewId, int width, int height, uint32_t clearCol
 
 	m_toolBox.RegisterTool(new CDragTool());
 	m_toolBox.RegisterTool(new CExtrudeTool());
+	m_toolBox.RegisterTool(new CSelectTool());
 
 }
 
@@ -43,7 +44,9 @@ void CUIView::Draw(float dt)
 {
 	CBaseView::Draw(dt);
 
-
+	// Everything edited since the last frame gets rebuilt in one go, right before anyone looks at it
+	GetWorldEditor().FlushUpdates();
+	GetWorldEditor().PageOutIdle();
 
 	for (int i = 0; i < 3; i++)
 		m_editViews[i].Draw(dt);
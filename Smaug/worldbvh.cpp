@@ -0,0 +1,516 @@
+#include "worldbvh.h"
+#include "worldeditor.h"
+
+#include <algorithm>
+#include <bit>
+
+// Past this depth, builds split down the middle instead of by SAH so we're guaranteed to stay under BVH_MAX_DEPTH
+#define BVH_SAH_DEPTH 28
+#define BVH_BIN_COUNT 12
+
+CWorldBVH::CWorldBVH()
+{
+	m_root = -1;
+	m_leafCount = 0;
+	m_builtCost = 0;
+	m_changes = 0;
+}
+
+void CWorldBVH::Clear()
+{
+	for (auto& n : m_tree)
+		if (n.node)
+			n.node->m_bvhLeaf = -1;
+
+	m_tree.clear();
+	m_free.clear();
+	m_root = -1;
+	m_leafCount = 0;
+	m_builtCost = 0;
+	m_changes = 0;
+}
+
+int CWorldBVH::AllocNode()
+{
+	if (m_free.size())
+	{
+		int index = m_free.back();
+		m_free.pop_back();
+		m_tree[index] = {};
+		return index;
+	}
+
+	m_tree.emplace_back();
+	return m_tree.size() - 1;
+}
+
+void CWorldBVH::FreeNode(int index)
+{
+	m_tree[index] = {};
+	m_free.push_back(index);
+}
+
+void CWorldBVH::Build(std::vector<CNode*>& nodes)
+{
+	Clear();
+	if (nodes.size() == 0)
+		return;
+
+	m_tree.reserve(nodes.size() * 2);
+
+	std::vector<bvhBuildItem_t> items;
+	items.reserve(nodes.size());
+	for (auto node : nodes)
+	{
+		int leaf = AllocNode();
+		m_tree[leaf].aabb = node->GetAbsAABB();
+		m_tree[leaf].node = node;
+		node->m_bvhLeaf = leaf;
+		items.push_back({ leaf, (m_tree[leaf].aabb.min + m_tree[leaf].aabb.max) * 0.5f });
+	}
+
+	m_root = BuildRange(items, 0, items.size(), 0);
+	m_leafCount = nodes.size();
+	m_builtCost = Cost();
+	m_changes = 0;
+}
+
+// Binned SAH. Splits the centers of the range along their longest axis, wherever the two sides come out cheapest
+int CWorldBVH::BuildRange(std::vector<bvhBuildItem_t>& items, int start, int end, int depth)
+{
+	if (end - start == 1)
+		return items[start].leaf;
+
+	aabb_t centers = { items[start].center, items[start].center };
+	for (int i = start + 1; i < end; i++)
+		centers = aabbUnion(centers, { items[i].center, items[i].center });
+
+	glm::vec3 extents = centers.max - centers.min;
+	int axis = 0;
+	if (extents.y > extents[axis])
+		axis = 1;
+	if (extents.z > extents[axis])
+		axis = 2;
+
+	float extent = extents[axis];
+	float low = centers.min[axis];
+	auto binOf = [&](const bvhBuildItem_t& item)
+	{
+		int bin = (item.center[axis] - low) / extent * BVH_BIN_COUNT;
+		return std::min(bin, BVH_BIN_COUNT - 1);
+	};
+
+	int mid = start;
+	if (extent > 0 && depth < BVH_SAH_DEPTH)
+	{
+		aabb_t binBox[BVH_BIN_COUNT];
+		int binCount[BVH_BIN_COUNT] = {};
+		for (int i = start; i < end; i++)
+		{
+			int bin = binOf(items[i]);
+			aabb_t box = m_tree[items[i].leaf].aabb;
+			binBox[bin] = binCount[bin] ? aabbUnion(binBox[bin], box) : box;
+			binCount[bin]++;
+		}
+
+		// Sweep in from the right to get the cost of everything past each split
+		float rightCost[BVH_BIN_COUNT] = {};
+		aabb_t box;
+		int count = 0;
+		for (int b = BVH_BIN_COUNT - 1; b > 0; b--)
+		{
+			if (binCount[b])
+			{
+				box = count ? aabbUnion(box, binBox[b]) : binBox[b];
+				count += binCount[b];
+			}
+			rightCost[b] = count ? aabbArea(box) * count : 0;
+		}
+
+		// And then from the left to find the cheapest split
+		int bestSplit = -1;
+		float bestCost = FLT_MAX;
+		count = 0;
+		for (int b = 0; b < BVH_BIN_COUNT - 1; b++)
+		{
+			if (binCount[b])
+			{
+				box = count ? aabbUnion(box, binBox[b]) : binBox[b];
+				count += binCount[b];
+			}
+
+			if (count == 0 || count == end - start)
+				continue;
+
+			float cost = aabbArea(box) * count + rightCost[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = b;
+			}
+		}
+
+		if (bestSplit != -1)
+			mid = std::partition(items.begin() + start, items.begin() + end, [&](const bvhBuildItem_t& item) { return binOf(item) <= bestSplit; }) - items.begin();
+	}
+
+	// Everything's stacked up on top of eachother, or we're getting too deep. Just split it in half
+	if (mid == start || mid == end)
+	{
+		mid = (start + end) / 2;
+		std::nth_element(items.begin() + start, items.begin() + mid, items.begin() + end, [&](const bvhBuildItem_t& a, const bvhBuildItem_t& b) { return a.center[axis] < b.center[axis]; });
+	}
+
+	int left = BuildRange(items, start, mid, depth + 1);
+	int right = BuildRange(items, mid, end, depth + 1);
+
+	int index = AllocNode();
+	m_tree[index].children[0] = left;
+	m_tree[index].children[1] = right;
+	m_tree[index].aabb = aabbUnion(m_tree[left].aabb, m_tree[right].aabb);
+	m_tree[index].height = 1 + std::max(m_tree[left].height, m_tree[right].height);
+	m_tree[left].parent = index;
+	m_tree[right].parent = index;
+	return index;
+}
+
+void CWorldBVH::Rebuild()
+{
+	std::vector<CNode*> nodes;
+	nodes.reserve(m_leafCount);
+	for (auto& n : m_tree)
+		if (n.node)
+			nodes.push_back(n.node);
+
+	Build(nodes);
+}
+
+void CWorldBVH::Insert(CNode* node)
+{
+	if (node->m_bvhLeaf != -1)
+	{
+		Refit(node);
+		return;
+	}
+
+	int leaf = AllocNode();
+	aabb_t box = node->GetAbsAABB();
+	m_tree[leaf].aabb = box;
+	m_tree[leaf].node = node;
+	node->m_bvhLeaf = leaf;
+	m_leafCount++;
+
+	if (m_root == -1)
+	{
+		m_root = leaf;
+		m_builtCost = Cost();
+		return;
+	}
+
+	// Walk down towards whichever side has to grow the least to fit us
+	int sibling = m_root;
+	while (m_tree[sibling].children[0] != -1)
+	{
+		float area = aabbArea(m_tree[sibling].aabb);
+		float combined = aabbArea(aabbUnion(m_tree[sibling].aabb, box));
+
+		// Cost of pairing up with this whole branch
+		float cost = 2.0f * combined;
+
+		// Going any deeper still grows this branch
+		float inherited = 2.0f * (combined - area);
+
+		float childCost[2];
+		for (int i = 0; i < 2; i++)
+		{
+			bvhNode_t& child = m_tree[m_tree[sibling].children[i]];
+			float grown = aabbArea(aabbUnion(child.aabb, box));
+			if (child.children[0] == -1)
+				childCost[i] = grown + inherited;
+			else
+				childCost[i] = grown - aabbArea(child.aabb) + inherited;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+
+		sibling = m_tree[sibling].children[childCost[0] < childCost[1] ? 0 : 1];
+	}
+
+	// Slot a new branch in above the sibling to hold the both of us
+	int oldParent = m_tree[sibling].parent;
+	int parent = AllocNode();
+	m_tree[parent].parent = oldParent;
+	m_tree[parent].children[0] = sibling;
+	m_tree[parent].children[1] = leaf;
+	m_tree[parent].aabb = aabbUnion(m_tree[sibling].aabb, box);
+	m_tree[parent].height = 1 + m_tree[sibling].height;
+	m_tree[sibling].parent = parent;
+	m_tree[leaf].parent = parent;
+
+	if (oldParent == -1)
+		m_root = parent;
+	else
+	{
+		int slot = m_tree[oldParent].children[0] == sibling ? 0 : 1;
+		m_tree[oldParent].children[slot] = parent;
+		RefitUp(oldParent);
+	}
+
+	m_changes++;
+	if (m_tree[m_root].height >= BVH_MAX_DEPTH)
+		Rebuild();
+	else
+		RebuildIfSloppy();
+}
+
+void CWorldBVH::Remove(CNode* node)
+{
+	int leaf = node->m_bvhLeaf;
+	if (leaf == -1)
+		return;
+
+	node->m_bvhLeaf = -1;
+	m_leafCount--;
+
+	if (leaf == m_root)
+	{
+		FreeNode(leaf);
+		m_root = -1;
+		return;
+	}
+
+	// Our sibling takes our parent's place
+	int parent = m_tree[leaf].parent;
+	int grandparent = m_tree[parent].parent;
+	int sibling = m_tree[parent].children[0] == leaf ? m_tree[parent].children[1] : m_tree[parent].children[0];
+
+	m_tree[sibling].parent = grandparent;
+	if (grandparent == -1)
+		m_root = sibling;
+	else
+	{
+		int slot = m_tree[grandparent].children[0] == parent ? 0 : 1;
+		m_tree[grandparent].children[slot] = sibling;
+		RefitUp(grandparent);
+	}
+
+	FreeNode(parent);
+	FreeNode(leaf);
+
+	m_changes++;
+	RebuildIfSloppy();
+}
+
+void CWorldBVH::Refit(CNode* node)
+{
+	int leaf = node->m_bvhLeaf;
+	if (leaf == -1)
+	{
+		Insert(node);
+		return;
+	}
+
+	m_tree[leaf].aabb = node->GetAbsAABB();
+	RefitUp(m_tree[leaf].parent);
+
+	m_changes++;
+	RebuildIfSloppy();
+}
+
+void CWorldBVH::RefitUp(int index)
+{
+	while (index != -1)
+	{
+		bvhNode_t& n = m_tree[index];
+		n.aabb = aabbUnion(m_tree[n.children[0]].aabb, m_tree[n.children[1]].aabb);
+		n.height = 1 + std::max(m_tree[n.children[0]].height, m_tree[n.children[1]].height);
+		index = n.parent;
+	}
+}
+
+float CWorldBVH::Cost()
+{
+	if (m_root == -1)
+		return 0;
+
+	float rootArea = aabbArea(m_tree[m_root].aabb);
+	if (rootArea <= 0)
+		return 0;
+
+	float cost = 0;
+	std::vector<int> stack = { m_root };
+	while (stack.size())
+	{
+		int index = stack.back();
+		stack.pop_back();
+
+		bvhNode_t& n = m_tree[index];
+		if (n.children[0] == -1)
+			continue;
+
+		cost += aabbArea(n.aabb);
+		stack.push_back(n.children[0]);
+		stack.push_back(n.children[1]);
+	}
+
+	return cost / rootArea;
+}
+
+void CWorldBVH::RebuildIfSloppy()
+{
+	// Checking the cost walks the whole tree, so only do it every so often
+	if (m_changes < std::max<size_t>(16, m_leafCount / 8))
+		return;
+	m_changes = 0;
+
+	if (Cost() > m_builtCost * 1.3f)
+		Rebuild();
+}
+
+void CWorldBVH::TraceRay(ray_t ray, testRayPlane_t& closest, void (*test)(ray_t ray, CNode* node, testRayPlane_t& closest))
+{
+	if (m_root == -1)
+		return;
+
+	glm::vec3 invDir = 1.0f / ray.dir;
+
+	// The nearer child is always on top, with the further one waiting under it
+	struct
+	{
+		int index;
+		float enter;
+	} stack[BVH_MAX_DEPTH + 2];
+	int top = 0;
+
+	float enter;
+	if (!rayAABBSlab(m_tree[m_root].aabb, ray.origin, invDir, closest.t, enter))
+		return;
+	stack[top++] = { m_root, enter };
+
+	while (top)
+	{
+		int index = stack[--top].index;
+
+		// Something closer turned up since this was pushed
+		if (stack[top].enter > closest.t)
+			continue;
+
+		bvhNode_t& n = m_tree[index];
+		if (n.children[0] == -1)
+		{
+			test(ray, n.node, closest);
+			continue;
+		}
+
+		float enter0, enter1;
+		bool hit0 = rayAABBSlab(m_tree[n.children[0]].aabb, ray.origin, invDir, closest.t, enter0);
+		bool hit1 = rayAABBSlab(m_tree[n.children[1]].aabb, ray.origin, invDir, closest.t, enter1);
+
+		if (hit0 && hit1)
+		{
+			if (enter0 <= enter1)
+			{
+				stack[top++] = { n.children[1], enter1 };
+				stack[top++] = { n.children[0], enter0 };
+			}
+			else
+			{
+				stack[top++] = { n.children[0], enter0 };
+				stack[top++] = { n.children[1], enter1 };
+			}
+		}
+		else if (hit0)
+			stack[top++] = { n.children[0], enter0 };
+		else if (hit1)
+			stack[top++] = { n.children[1], enter1 };
+	}
+}
+
+void CWorldBVH::TracePacket(const rayPacket_t& packet, testRayPlane_t* closest, void (*test)(const rayPacket_t& packet, int active, CNode* node, testRayPlane_t* closest))
+{
+	if (m_root == -1)
+		return;
+
+	// Only test can change closest, so maxT is gathered back up after every call to it
+	float maxT[RAY_PACKET_SIZE];
+	float enter[RAY_PACKET_SIZE];
+	auto gatherT = [&]()
+	{
+		for (int r = 0; r < packet.count; r++)
+			maxT[r] = closest[r].t;
+	};
+
+	// Nearest of the rays that hit, or FLT_MAX if none did
+	auto nearest = [&](int hits)
+	{
+		float n = FLT_MAX;
+		for (unsigned int b = hits; b; b &= b - 1)
+			n = std::min(n, enter[std::countr_zero(b)]);
+		return n;
+	};
+
+	// Same as TraceRay, but every entry carries the rays that made it this far
+	struct
+	{
+		int index;
+		int rays;
+		float enter;
+	} stack[BVH_MAX_DEPTH + 2];
+	int top = 0;
+
+	gatherT();
+	int hits = rayPacketAABBTest(packet, (1 << packet.count) - 1, m_tree[m_root].aabb, maxT, enter);
+	if (!hits)
+		return;
+	stack[top++] = { m_root, hits, nearest(hits) };
+
+	while (top)
+	{
+		top--;
+		int index = stack[top].index;
+		int rays = stack[top].rays;
+
+		// Drop the rays that found something closer since this was pushed
+		int still = 0;
+		for (unsigned int b = rays; b; b &= b - 1)
+		{
+			int r = std::countr_zero(b);
+			if (stack[top].enter <= maxT[r])
+				still |= 1 << r;
+		}
+		if (!still)
+			continue;
+
+		bvhNode_t& n = m_tree[index];
+		if (n.children[0] == -1)
+		{
+			test(packet, still, n.node, closest);
+			gatherT();
+			continue;
+		}
+
+		int hits0 = rayPacketAABBTest(packet, still, m_tree[n.children[0]].aabb, maxT, enter);
+		float enter0 = nearest(hits0);
+		int hits1 = rayPacketAABBTest(packet, still, m_tree[n.children[1]].aabb, maxT, enter);
+		float enter1 = nearest(hits1);
+
+		if (hits0 && hits1)
+		{
+			if (enter0 <= enter1)
+			{
+				stack[top++] = { n.children[1], hits1, enter1 };
+				stack[top++] = { n.children[0], hits0, enter0 };
+			}
+			else
+			{
+				stack[top++] = { n.children[0], hits0, enter0 };
+				stack[top++] = { n.children[1], hits1, enter1 };
+			}
+		}
+		else if (hits0)
+			stack[top++] = { n.children[0], hits0, enter0 };
+		else if (hits1)
+			stack[top++] = { n.children[1], hits1, enter1 };
+	}
+}
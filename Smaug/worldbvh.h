@@ -0,0 +1,190 @@
+#pragma once
+#include "raytest.h"
+
+#include <vector>
+
+class CNode;
+
+// Bounding volume hierarchy over the AABBs of every node in the world
+// Nodes are refit in place as they change. Once refitting has let the tree get too sloppy, it's rebuilt from scratch with SAH
+// This is the world's one spatial index. Rays, boxes, columns and nearest queries all go through here instead of looping over every node
+class CWorldBVH
+{
+public:
+	CWorldBVH();
+
+	void Clear();
+
+	// Throws out the tree and builds a fresh one over nodes
+	void Build(std::vector<CNode*>& nodes);
+
+	void Insert(CNode* node);
+	void Remove(CNode* node);
+
+	// Call after a node's AABB or origin changes
+	void Refit(CNode* node);
+
+	// Runs test on every node whose AABB the ray passes through, nearest first
+	// Nodes that start further along the ray than closest.t are skipped, so test should only ever shrink closest.t
+	void TraceRay(ray_t ray, testRayPlane_t& closest, void (*test)(ray_t ray, CNode* node, testRayPlane_t& closest));
+
+	// TraceRay for a whole packet at once. A node is visited if any ray in the packet gets to it, and test is told which ones did
+	void TracePacket(const rayPacket_t& packet, testRayPlane_t* closest, void (*test)(const rayPacket_t& packet, int active, CNode* node, testRayPlane_t* closest));
+
+	// Runs test on every node whose AABB, grown by bloat, holds point on the axes left in axisMask
+	// Masked out axes are ignored, so this picks up everything in the column under the mouse
+	template<typename T>
+	void FindInColumn(glm::vec3 point, glm::vec3 axisMask, float bloat, T test);
+
+	// Runs test on every node whose AABB overlaps box on the axes left in axisMask
+	template<typename T>
+	void FindInBox(aabb_t box, glm::vec3 axisMask, T test);
+
+	// Finds the node closest to point, within maxDistance on the axes left in axisMask
+	// test gives the real distance to a node, or FLT_MAX to skip it. Only nodes whose AABB is closer than the best so far get tested
+	template<typename T>
+	CNode* FindNearest(glm::vec3 point, glm::vec3 axisMask, float maxDistance, T test);
+
+	size_t LeafCount() { return m_leafCount; }
+
+private:
+	struct bvhNode_t
+	{
+		aabb_t aabb;
+		int parent = -1;
+
+		// Both are -1 on leaves
+		int children[2] = { -1, -1 };
+
+		// Only set on leaves
+		CNode* node = nullptr;
+
+		// Leaves are 0
+		int height = 0;
+	};
+
+	int AllocNode();
+	void FreeNode(int index);
+
+	struct bvhBuildItem_t
+	{
+		int leaf;
+		glm::vec3 center;
+	};
+
+	int BuildRange(std::vector<bvhBuildItem_t>& items, int start, int end, int depth);
+	void Rebuild();
+	void RefitUp(int index);
+
+	// Sum of the surface area of every branch, relative to the root's
+	float Cost();
+	void RebuildIfSloppy();
+
+	std::vector<bvhNode_t> m_tree;
+	std::vector<int> m_free;
+	int m_root;
+	size_t m_leafCount;
+
+	// How good the tree was right after the last build, and how much it's been messed with since
+	float m_builtCost;
+	size_t m_changes;
+};
+
+// Tallest we'll let the tree get before rebuilding it. Keeps the traversal stack a fixed size
+#define BVH_MAX_DEPTH 48
+
+template<typename T>
+void CWorldBVH::FindInColumn(glm::vec3 point, glm::vec3 axisMask, float bloat, T test)
+{
+	FindInBox({ point - bloat, point + bloat }, axisMask, test);
+}
+
+template<typename T>
+void CWorldBVH::FindInBox(aabb_t box, glm::vec3 axisMask, T test)
+{
+	if (m_root == -1)
+		return;
+
+	auto overlaps = [&](const aabb_t& aabb)
+	{
+		for (int i = 0; i < 3; i++)
+			if (axisMask[i] != 0 && (box.max[i] < aabb.min[i] || box.min[i] > aabb.max[i]))
+				return false;
+		return true;
+	};
+
+	int stack[BVH_MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = m_root;
+
+	while (top)
+	{
+		bvhNode_t& n = m_tree[stack[--top]];
+		if (!overlaps(n.aabb))
+			continue;
+
+		if (n.children[0] == -1)
+		{
+			test(n.node);
+			continue;
+		}
+
+		stack[top++] = n.children[1];
+		stack[top++] = n.children[0];
+	}
+}
+
+template<typename T>
+CNode* CWorldBVH::FindNearest(glm::vec3 point, glm::vec3 axisMask, float maxDistance, T test)
+{
+	if (m_root == -1)
+		return nullptr;
+
+	CNode* best = nullptr;
+	float bestSq = maxDistance * maxDistance;
+
+	// The nearer child is always on top, with the further one waiting under it
+	struct
+	{
+		int index;
+		float distSq;
+	} stack[BVH_MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = { m_root, aabbDistanceSq(m_tree[m_root].aabb, point, axisMask) };
+
+	while (top)
+	{
+		top--;
+
+		// Something closer turned up since this was pushed
+		if (stack[top].distSq > bestSq)
+			continue;
+
+		bvhNode_t& n = m_tree[stack[top].index];
+		if (n.children[0] == -1)
+		{
+			float dist = test(n.node);
+			if (dist != FLT_MAX && dist * dist <= bestSq)
+			{
+				best = n.node;
+				bestSq = dist * dist;
+			}
+			continue;
+		}
+
+		float dist0 = aabbDistanceSq(m_tree[n.children[0]].aabb, point, axisMask);
+		float dist1 = aabbDistanceSq(m_tree[n.children[1]].aabb, point, axisMask);
+		if (dist0 <= dist1)
+		{
+			stack[top++] = { n.children[1], dist1 };
+			stack[top++] = { n.children[0], dist0 };
+		}
+		else
+		{
+			stack[top++] = { n.children[0], dist0 };
+			stack[top++] = { n.children[1], dist1 };
+		}
+	}
+
+	return best;
+}
@@ -3,59 +3,68 @@
 #include "tessellate.h"
 #include "slice.h"
 #include "log.h"
+#include "parallel.h"
 
 #include <glm/geometric.hpp>
 #include <glm/common.hpp>
+#include <algorithm>
 
 /////////////////////
 // Safe References //
 /////////////////////
 
 // Node Reference
-CNodeRef::CNodeRef()              : m_targetId(INVALID_NODE_ID) {}
-CNodeRef::CNodeRef(nodeId_t id)   : m_targetId(id)              {}
-CNodeRef::CNodeRef(CNode* node) { if (node) m_targetId = node->NodeID(); else m_targetId = INVALID_NODE_ID; }
+CNodeRef::CNodeRef()                                     : m_targetId(INVALID_NODE_ID), m_targetGeneration(0) {}
+CNodeRef::CNodeRef(nodeId_t id)                          : m_targetId(id), m_targetGeneration(GetWorldEditor().m_nodes.generation(id)) {}
+CNodeRef::CNodeRef(nodeId_t id, nodeGen_t generation)    : m_targetId(id), m_targetGeneration(generation) {}
+CNodeRef::CNodeRef(CNode* node) { if (node) { m_targetId = node->NodeID(); m_targetGeneration = node->NodeGeneration(); } else { m_targetId = INVALID_NODE_ID; m_targetGeneration = 0; } }
 bool CNodeRef::IsValid() const { return Node() != nullptr; }
-CNode* CNodeRef::operator->() const { return GetWorldEditor().GetNode(m_targetId); }
-CNode* CNodeRef::Node() const { return GetWorldEditor().GetNode(m_targetId); }
-void CNodeRef::operator=(const CNodeRef& ref) { m_targetId = ref.m_targetId;}
+CNode* CNodeRef::operator->() const { return GetWorldEditor().GetNode(m_targetId, m_targetGeneration); }
+CNode* CNodeRef::Node() const { return GetWorldEditor().GetNode(m_targetId, m_targetGeneration); }
+void CNodeRef::operator=(const CNodeRef& ref) { m_targetId = ref.m_targetId; m_targetGeneration = ref.m_targetGeneration; }
 
 
-CNodeMeshPartRef::CNodeMeshPartRef() : m_partId(INVALID_MESH_ID), m_node(INVALID_NODE_ID) {}
+// Paged out nodes have their parts packed away. Shaping the node brings them back, in the same spots
+static meshPart_t* nodePart(CNode* node, meshId_t partId)
+{
+	if (!node)
+		return nullptr;
+
+	GetWorldEditor().MaterialiseShape(node);
+	std::vector<meshPart_t*>& parts = node->m_mesh.parts;
+	return partId < parts.size() ? parts[partId] : nullptr;
+}
+
+CNodeMeshPartRef::CNodeMeshPartRef() : m_partId(INVALID_MESH_ID), m_node() {}
 CNodeMeshPartRef::CNodeMeshPartRef(meshPart_t* part, CNodeRef node) : CNodeMeshPartRef()
 {
 	if (!node.IsValid() || !part)
 		return;
 
+	// Parts know where they sit. Just make sure it's actually ours
 	std::vector<meshPart_t*>& parts = node->m_mesh.parts;
-	auto f = std::find(parts.begin(), parts.end(), part);
-	if (f != parts.end())
+	if (part->id < parts.size() && parts[part->id] == part)
 	{
-		// Found it!
 		m_node = node;
-		size_t id = f - parts.begin();
-		SASSERT(id < MAX_MESH_ID);
-		m_partId = id;
+		m_partId = part->id;
 	}
 }
 
+CNodeMeshPartRef::CNodeMeshPartRef(CNodeRef node, meshId_t partId) : m_node(node), m_partId(partId) {}
+
 const bool CNodeMeshPartRef::IsValid()
 {
-	return m_partId != MAX_MESH_ID && m_node.IsValid();
+	return m_partId != MAX_MESH_ID && nodePart(m_node.Node(), m_partId);
 }
 
 meshPart_t* CNodeMeshPartRef::operator->() const
 {
-	if(m_node->m_mesh.parts.size() > m_partId)
-		return m_node->m_mesh.parts[m_partId];
-	return nullptr;
+	return nodePart(m_node.Node(), m_partId);
 }
 
 CNodeMeshPartRef::operator meshPart_t* () const
 {
-	if (m_node->m_mesh.parts.size() > m_partId)
-		return m_node->m_mesh.parts[m_partId];
-	return nullptr;
+	return nodePart(m_node.Node(), m_partId);
 }
 
 void CNodeMeshPartRef::operator=(const CNodeMeshPartRef& ref)
@@ -73,16 +82,12 @@ CNodeHalfEdgeRef::CNodeHalfEdgeRef(halfEdge_t* he, CNodeRef node) : CNodeHalfEdg
 	if (!node.IsValid() || !he)
 		return;
 	m_part = { (meshPart_t*)he->face, node };
+	if (!m_part.IsValid())
+		return;
 
 	std::vector<halfEdge_t*>& edges = m_part->edges;
-	auto f = std::find(edges.begin(), edges.end(), he);
-	if (f != edges.end())
-	{
-		// Found it!
-		size_t id = f - edges.begin();
-		SASSERT(id < MAX_MESH_ID);
-		m_heId = id;
-	}
+	if (he->id < edges.size() && edges[he->id] == he)
+		m_heId = he->id;
 }
 
 const bool CNodeHalfEdgeRef::IsValid()
@@ -111,24 +116,22 @@ void CNodeHalfEdgeRef::operator=(const CNodeHalfEdgeRef& ref)
 }
 
 
-CNodeVertexRef::CNodeVertexRef() : m_vertId(MAX_MESH_ID), m_part(nullptr, MAX_MESH_ID) {}
+CNodeVertexRef::CNodeVertexRef() : m_vertId(MAX_MESH_ID), m_part() {}
 CNodeVertexRef::CNodeVertexRef(vertex_t* vertex, CNodeRef node) : CNodeVertexRef()
 {
 	if (!node.IsValid() || !vertex)
 		return;
 	m_part = { (meshPart_t*)vertex->edge->face, node };
+	if (!m_part.IsValid())
+		return;
 
 	std::vector<vertex_t*>& verts = m_part->verts;
-	auto f = std::find(verts.begin(), verts.end(), vertex);
-	if (f != verts.end())
-	{
-		// Found it!
-		size_t id = f - verts.begin();
-		SASSERT(id < MAX_MESH_ID);
-		m_vertId = id;
-	}
+	if (vertex->id < verts.size() && verts[vertex->id] == vertex)
+		m_vertId = vertex->id;
 }
 
+CNodeVertexRef::CNodeVertexRef(CNodeMeshPartRef part, meshId_t vertId) : m_part(part), m_vertId(vertId) {}
+
 bool CNodeVertexRef::IsValid()
 {
 	return m_part.IsValid() && m_part->verts.size() > m_vertId && m_part->verts[m_vertId];
@@ -157,34 +160,46 @@ void CNodeVertexRef::operator=(const CNodeVertexRef& ref)
 
 CWorldEditor::CWorldEditor()
 {
-	m_currentNodeId = 0;
+	m_editEpoch = 0;
 }
 
 void CWorldEditor::Clear()
 {
-	m_currentNodeId = 0;
-	for (auto p : m_nodes)
-		delete p.second;
+	m_bvh.Clear();
+	m_sweep.Clear();
+	m_updateQueue.clear();
+	m_regions.clear();
+	m_editEpoch++;
+	for (auto n : m_nodes)
+		delete n;
 	m_nodes.clear();
+
+	for (auto& shape : m_instances)
+		for (auto i : shape.second)
+			delete i;
+	m_instances.clear();
+	m_loneShapes.clear();
 }
 
 void CWorldEditor::RegisterNode(CNode* node)
 {
-	m_nodes.emplace(m_currentNodeId, node);
-
-	node->m_id = m_currentNodeId;
-	m_currentNodeId++;
+	size_t id = m_nodes.insert(node);
 
 	// If this ever happens, it'll be awful.
-	SASSERT(m_currentNodeId != INVALID_NODE_ID);
+	SASSERT(id < INVALID_NODE_ID);
+
+	node->m_id = id;
+	node->m_generation = m_nodes.generation(id);
+	m_bvh.Insert(node);
+	m_sweep.Insert(node, m_bvh);
+	m_editEpoch++;
 }
 
-bool CWorldEditor::AssignID(CNode* node, nodeId_t id)
+bool CWorldEditor::AssignID(CNode* node, nodeId_t id, nodeGen_t generation, bool place)
 {
-	// If we're one ahead of the cur, increment it. It'll make life easier
-	if (id == m_currentNodeId + 1)
-		m_currentNodeId++;
-	
+	if (id == INVALID_NODE_ID)
+		return false;
+
 	// We're assigning an arbitrary id. Check if it's not in use.
 	if (m_nodes.contains(id))
 	{
@@ -192,34 +207,49 @@ bool CWorldEditor::AssignID(CNode* node, nodeId_t id)
 		return false;
 	}
 
-	// Is this free?
-	nodeId_t oldId = node->m_id;
-	if (oldId != INVALID_NODE_ID)
+	// Were we somewhere else?
+	bool inBVH = false;
+	if (node->m_id != INVALID_NODE_ID && m_nodes.get(node->m_id) == node)
 	{
-		if (m_nodes.contains(oldId))
-		{
-			// Remove the existing ref
-			m_nodes.erase(oldId);
+		// Everything we're connected to knows us by our old ref
+		m_sweep.Remove(node);
 
-		}
+		// Remove the existing ref
+		m_nodes.remove(node->m_id);
+		inBVH = true;
 	}
 
-	m_nodes.emplace(id, node);
+	m_nodes.insertAt(id, generation, node);
 	node->m_id = id;
+	node->m_generation = generation;
+	if (place)
+	{
+		if (!inBVH)
+			m_bvh.Insert(node);
+		m_sweep.Insert(node, m_bvh);
+	}
+	m_editEpoch++;
 
 	return true;
 }
 
 void CWorldEditor::DeleteNode(CNode* node)
 {
+	// Whatever we were cutting needs to have our cuts taken back out. Anything paged out has none to take out
+	for (auto c : node->m_cutting)
+		if (c.IsValid() && c->State() == NodeState::BUILT)
+			QueueUpdate(c.Node(), false);
+
+	// Anything in the BVH is in the sweep too
+	if (node->m_bvhLeaf != -1)
+		m_sweep.Remove(node);
+
 	nodeId_t id = node->m_id;
-	if (id != INVALID_NODE_ID)
-	{
-		if (m_nodes.contains(id))
-		{
-			m_nodes.erase(id);
-		}
-	}
+	if (id != INVALID_NODE_ID && m_nodes.get(id) == node)
+		m_nodes.remove(id);
+	m_bvh.Remove(node);
+	ReleaseInstance(node);
+	m_editEpoch++;
 
 	delete node;
 }
@@ -231,11 +261,417 @@ CQuadNode* CWorldEditor::CreateQuad()
 	return node;
 }
 
-CNode* CWorldEditor::GetNode(nodeId_t id)
+// Cutters in ID order, so we get the same cuts every time
+static void gatherCutters(CNode* node, std::vector<mesh_t*>& cutters)
 {
-	if(!m_nodes.contains(id))
-		return nullptr;
-	return m_nodes[id];
+	std::vector<CNode*> touching;
+	for (auto& c : node->m_cutters)
+		if (c.IsValid())
+			touching.push_back(c.Node());
+	std::sort(touching.begin(), touching.end(), [](CNode* a, CNode* b) { return a->NodeID() < b->NodeID(); });
+
+	for (auto c : touching)
+		cutters.push_back(&c->m_mesh);
+}
+
+void CWorldEditor::PlaceAll()
+{
+	// Ordered by ID so the rebuild is the same every time
+	std::vector<CNode*> nodes;
+	nodes.reserve(m_nodes.count());
+	for (auto n : m_nodes)
+		nodes.push_back(n);
+	std::sort(nodes.begin(), nodes.end(), [](CNode* a, CNode* b) { return a->NodeID() < b->NodeID(); });
+
+	// Anything built is about to be out of place. bgfx wants its half of this on the main thread
+	for (auto n : nodes)
+		n->PageOut();
+	m_regions.clear();
+
+	parallelFor(nodes.size(), [&](size_t i)
+	{
+		nodes[i]->Recenter();
+		nodes[i]->CalculateAABB();
+	});
+
+	// Every AABB is settled now. Much faster to build the BVH and sweep from scratch than to move nodes in one at a time
+	// The sweep connects up everything that touches, so we know who can cut who once they're built
+	m_bvh.Build(nodes);
+	m_sweep.Build(nodes);
+
+	m_editEpoch++;
+}
+
+void CWorldEditor::RebuildAll()
+{
+	PlaceAll();
+	MaterialiseAll();
+}
+
+uint64_t CWorldEditor::RegionKey(CNode* node)
+{
+	aabb_t aabb = node->GetAbsAABB();
+	glm::vec3 center = (aabb.min + aabb.max) / 2.0f;
+
+	// 21 bits an axis still goes hundreds of millions of units out either way
+	uint64_t key = 0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		int32_t cell = (int32_t)floorf(center[axis] / WORLD_REGION_SIZE);
+		key = key << 21 | (uint32_t)(cell & 0x1FFFFF);
+	}
+	return key;
+}
+
+aabb_t CWorldEditor::RegionBox(uint64_t key)
+{
+	glm::vec3 min;
+	for (int axis = 2; axis >= 0; axis--)
+	{
+		// Sign extend back out of the 21 bits
+		int32_t cell = (int32_t)((uint32_t)(key & 0x1FFFFF) << 11) >> 11;
+		min[axis] = cell * WORLD_REGION_SIZE;
+		key >>= 21;
+	}
+	return { min, min + WORLD_REGION_SIZE };
+}
+
+CWorldEditor::region_t& CWorldEditor::TouchRegion(CNode* node)
+{
+	region_t& region = m_regions[RegionKey(node)];
+	region.lastTouched = m_frame;
+	return region;
+}
+
+void CWorldEditor::FindInRegion(uint64_t key, std::vector<CNode*>& nodes)
+{
+	// The BVH hands back everything overlapping the region. Only the ones centered in it are ours
+	m_bvh.FindInBox(RegionBox(key), { 1, 1, 1 }, [&](CNode* node)
+	{
+		if (RegionKey(node) == key)
+			nodes.push_back(node);
+	});
+}
+
+void CWorldEditor::ShapeDormant(std::vector<CNode*>& nodes)
+{
+	std::vector<CNode*> shape;
+	for (auto n : nodes)
+	{
+		if (n->m_state == NodeState::DORMANT)
+			shape.push_back(n);
+
+		for (auto& c : n->m_cutters)
+		{
+			CNode* cutter = c.Node();
+			if (cutter && cutter->m_state == NodeState::DORMANT)
+				shape.push_back(cutter);
+		}
+	}
+
+	// Neighbours share plenty of cutters
+	std::sort(shape.begin(), shape.end());
+	shape.erase(std::unique(shape.begin(), shape.end()), shape.end());
+
+	// Shapes only depend on their own node
+	parallelFor(shape.size(), [&](size_t i)
+	{
+		shape[i]->RebuildShape();
+	});
+
+	for (auto n : shape)
+	{
+		n->m_state = NodeState::SHAPED;
+		TouchRegion(n);
+	}
+}
+
+void CWorldEditor::Materialise(std::vector<CNode*>& nodes)
+{
+	std::vector<CNode*> build;
+	for (auto n : nodes)
+	{
+		uint64_t key = RegionKey(n);
+		region_t& region = m_regions[key];
+		region.lastTouched = m_frame;
+
+		// The first look at a region brings all of it in, so moving around inside it doesn't keep stopping to build
+		if (!region.pagedIn)
+		{
+			region.pagedIn = true;
+			FindInRegion(key, build);
+		}
+
+		if (n->m_state != NodeState::BUILT)
+			build.push_back(n);
+	}
+
+	build.erase(std::remove_if(build.begin(), build.end(), [](CNode* n) { return n->m_state == NodeState::BUILT; }), build.end());
+	if (build.size() == 0)
+		return;
+
+	// Ordered by ID so the build is the same every time
+	std::sort(build.begin(), build.end(), [](CNode* a, CNode* b) { return a->NodeID() < b->NodeID(); });
+	build.erase(std::unique(build.begin(), build.end()), build.end());
+
+	// Cuts need the shapes of everything touching us, built or not
+	ShapeDormant(build);
+
+	// Cuts only write to the node being cut and only read the shapes of their cutters, which are all done now
+	parallelFor(build.size(), [&](size_t i)
+	{
+		std::vector<mesh_t*> cutters;
+		gatherCutters(build[i], cutters);
+		build[i]->RebuildCuts(cutters);
+		build[i]->RebuildTessellation();
+	});
+
+	// bgfx wants this on the main thread
+	for (auto n : build)
+	{
+		RebuildRenderData(n);
+		n->m_state = NodeState::BUILT;
+	}
+}
+
+void CWorldEditor::MaterialiseAll()
+{
+	std::vector<CNode*> nodes;
+	nodes.reserve(m_nodes.count());
+	for (auto n : m_nodes)
+		nodes.push_back(n);
+	Materialise(nodes);
+}
+
+void CWorldEditor::MaterialiseShape(CNode* node)
+{
+	TouchRegion(node);
+	if (node->m_state != NodeState::DORMANT)
+		return;
+
+	node->RebuildShape();
+	node->m_state = NodeState::SHAPED;
+}
+
+// Anything actually cut up is a shape all its own
+static bool isCut(CNode* node)
+{
+	for (auto p : node->m_mesh.parts)
+		if (p->sliced)
+			return true;
+	return false;
+}
+
+void CWorldEditor::RebuildRenderData(CNode* node)
+{
+	// We might not be shaped like whatever we shared with last time
+	ReleaseInstance(node);
+
+	CMeshInstance* instance = nullptr;
+	if (!isCut(node))
+	{
+		uint64_t hash = meshShapeHash(node->m_mesh);
+		auto shape = m_instances.find(hash);
+		if (shape != m_instances.end())
+		{
+			for (auto i : shape->second)
+			{
+				if (i->Matches(node->m_mesh))
+				{
+					instance = i;
+					break;
+				}
+			}
+		}
+
+		if (!instance)
+		{
+			// Could've been edited or cut since it got here, so check it's still worth sharing with
+			auto lone = m_loneShapes.find(hash);
+			CNode* other = lone != m_loneShapes.end() ? lone->second.Node() : nullptr;
+			if (other && other != node && other->m_state == NodeState::BUILT && !other->m_instance && !isCut(other) && meshShapesMatch(other->m_mesh, node->m_mesh))
+			{
+				instance = new CMeshInstance(node->m_mesh, hash);
+				m_instances[hash].push_back(instance);
+				m_loneShapes.erase(lone);
+
+				other->m_renderData.FreeRenderData();
+				other->m_instance = instance;
+				other->m_lone = false;
+				instance->m_users++;
+			}
+			else
+			{
+				m_loneShapes[hash] = node;
+				node->m_lone = true;
+				node->m_loneHash = hash;
+			}
+		}
+	}
+
+	if (instance)
+	{
+		node->m_renderData.FreeRenderData();
+		node->m_instance = instance;
+		instance->m_users++;
+	}
+	else
+		node->m_renderData.RebuildRenderData();
+}
+
+void CWorldEditor::ReleaseInstance(CNode* node)
+{
+	// Someone else might've taken our spot since
+	if (node->m_lone)
+	{
+		auto lone = m_loneShapes.find(node->m_loneHash);
+		if (lone != m_loneShapes.end() && lone->second == node->Ref())
+			m_loneShapes.erase(lone);
+		node->m_lone = false;
+	}
+
+	CMeshInstance* instance = node->m_instance;
+	if (!instance)
+		return;
+
+	node->m_instance = nullptr;
+	if (--instance->m_users)
+		return;
+
+	// Nobody's left drawing through it
+	std::vector<CMeshInstance*>& shape = m_instances[instance->Hash()];
+	shape.erase(std::find(shape.begin(), shape.end(), instance));
+	if (shape.size() == 0)
+		m_instances.erase(instance->Hash());
+	delete instance;
+}
+
+void CWorldEditor::PageOutIdle()
+{
+	m_frame++;
+
+	std::vector<CNode*> nodes;
+	for (auto it = m_regions.begin(); it != m_regions.end();)
+	{
+		if (m_frame - it->second.lastTouched < WORLD_REGION_IDLE_FRAMES)
+		{
+			it++;
+			continue;
+		}
+
+		// Nothing's looked at anything in here in a while. Back down to just the packed meshes
+		// Anything waiting on FlushUpdates is about to be built again anyway
+		nodes.clear();
+		FindInRegion(it->first, nodes);
+		for (auto n : nodes)
+		{
+			if (n->m_updateQueued)
+				continue;
+			if (n->m_state != NodeState::DORMANT)
+				n->PageOut();
+			n->Pack();
+		}
+		it = m_regions.erase(it);
+	}
+}
+
+void CWorldEditor::QueueUpdate(CNode* node, bool recenter)
+{
+	if (recenter)
+		node->m_recenterQueued = true;
+
+	// Something's just been edited, even if it's already waiting on a flush. Hovers found before now can't be trusted
+	m_editEpoch++;
+
+	if (node->m_updateQueued)
+		return;
+	node->m_updateQueued = true;
+	m_updateQueue.push_back(node);
+}
+
+void CWorldEditor::FlushUpdates()
+{
+	if (m_updateQueue.size() == 0)
+		return;
+
+	// Anything deleted since it was queued is already gone
+	std::vector<CNode*> reshape;
+	for (auto& ref : m_updateQueue)
+		if (ref.IsValid())
+			reshape.push_back(ref.Node());
+	m_updateQueue.clear();
+
+	// Ordered by ID so the rebuild is the same every time
+	auto byId = [](CNode* a, CNode* b) { return a->NodeID() < b->NodeID(); };
+	std::sort(reshape.begin(), reshape.end(), byId);
+
+	// Shapes only depend on their own node
+	parallelFor(reshape.size(), [&](size_t i)
+	{
+		if (reshape[i]->m_recenterQueued)
+			reshape[i]->Recenter();
+		reshape[i]->RebuildShape();
+	});
+	for (auto n : reshape)
+		n->m_state = NodeState::SHAPED;
+
+	// Whatever we cut needs to be cut again, but its own shape is fine as is
+	// That's what we cut before moving, to take our old cuts out, and what we cut after, to put the new ones in
+	// m_updateQueued stays set until we're done, so nothing gets in here twice
+	// Anything that isn't built has no cuts to redo. It'll get them whenever it is
+	std::vector<CNode*> recut = reshape;
+	auto addCutting = [&](CNode* n)
+	{
+		for (auto c : n->m_cutting)
+		{
+			CNode* cut = c.Node();
+			if (cut && !cut->m_updateQueued && cut->m_state == NodeState::BUILT)
+			{
+				cut->m_updateQueued = true;
+				recut.push_back(cut);
+			}
+		}
+	};
+
+	for (auto n : reshape)
+		addCutting(n);
+
+	// Moving through the sweep connects and disconnects us from whatever we pass
+	for (auto n : reshape)
+	{
+		m_bvh.Refit(n);
+		m_sweep.Update(n);
+	}
+
+	for (auto n : reshape)
+		addCutting(n);
+	std::sort(recut.begin(), recut.end(), byId);
+
+	// Some of what we touch now could be paged out
+	ShapeDormant(recut);
+
+	// Every shape is settled, so the cuts only read finished cutters and write to their own node
+	parallelFor(recut.size(), [&](size_t i)
+	{
+		std::vector<mesh_t*> cutters;
+		gatherCutters(recut[i], cutters);
+		recut[i]->RebuildCuts(cutters);
+		recut[i]->RebuildTessellation();
+	});
+
+	// bgfx wants this on the main thread
+	for (auto n : recut)
+	{
+		RebuildRenderData(n);
+		n->m_state = NodeState::BUILT;
+		n->m_updateQueued = false;
+		n->m_recenterQueued = false;
+
+		// Whatever's being edited is being worked on, wherever it's moved to
+		TouchRegion(n);
+	}
+
+	m_editEpoch++;
 }
 
 /*
@@ -257,6 +693,8 @@ CWorldEditor& GetWorldEditor()
 
 CNode::CNode() : m_renderData(m_mesh), m_id(MAX_NODE_ID), m_visible(true)
 {
+	// We can end up in the BVH before our mesh is built
+	m_aabb = { { 0, 0, 0 }, { 0, 0, 0 } };
 }
 
 void CNode::Init()
@@ -274,37 +712,50 @@ void CNode::Init()
 	for(auto p : m_mesh.parts)
 		defineMeshPartFaces(*p);
 	CalculateAABB();
+	m_collisionBVHDirty = true;
 }
 
 void CNode::PreviewUpdate()
 {
-	PreviewUpdateThisOnly();
-
-	// Update what we're cutting
-	for (auto m : m_cutting)
-	{
-		m->PreviewUpdateThisOnly();
-	}
+	GetWorldEditor().QueueUpdate(this, false);
 }
 
-void CNode::PreviewUpdateThisOnly()
+void CNode::RebuildShape()
 {
+	Unpack();
 	CalculateAABB();
 
-
 	for (auto pa : m_mesh.parts)
 	{
 		defineMeshPartFaces(*pa);
-		convexifyMeshPartFaces(*pa, pa->collision);
 		optimizeParallelEdges(pa, pa->collision);
+		convexifyMeshPartFaces(*pa, pa->collision);
 	}
 
-	std::vector<mesh_t*> cutters;
-	for (auto c : GetWorldEditor().m_nodes)
-		if (c.second != this)
-			cutters.push_back(&c.second->m_mesh);
+	// Collision was just remade. Wait until someone wants to trace it before building the BVH back up
+	m_collisionBVHDirty = true;
+}
+
+CFaceBVH& CNode::CollisionBVH()
+{
+	// Keeps our region from being paged out while it's being queried, too
+	GetWorldEditor().MaterialiseShape(this);
+
+	if (m_collisionBVHDirty)
+	{
+		m_collisionBVH.Build(m_mesh);
+		m_collisionBVHDirty = false;
+	}
+	return m_collisionBVH;
+}
+
+void CNode::RebuildCuts(std::vector<mesh_t*>& cutters)
+{
 	applyCuts(&m_mesh, cutters);
+}
 
+void CNode::RebuildTessellation()
+{
 	for (auto pa : m_mesh.parts)
 	{
 		
@@ -326,56 +777,130 @@ void CNode::PreviewUpdateThisOnly()
 		
 		if (pa->sliced)
 		{
+			// Cleaned up once here. Both the convex pieces and the tris come off of these
 			optimizeParallelEdges(pa, pa->sliced->faces);
 			for (auto cf : pa->sliced->faces)
 			{
-				face_t* f = new face_t;
-				cloneFaceInto(cf, f);
-				f->parent = cf;
+				// Partition straight off of the face, so its cracks are still paired up into holes
 				std::vector<face_t*> temp;
-				temp.push_back(f);
-				convexifyMeshPartFaces(*pa, temp);
-				optimizeParallelEdges(pa, temp);
+				if (convexPartitionFace(*pa, cf, temp))
+				{
+					for (auto t : temp)
+						t->parent = cf;
+				}
+				else
+				{
+					face_t* f = new face_t;
+					cloneFaceInto(cf, f);
+					f->parent = cf;
+					temp.push_back(f);
+					convexifyMeshPartFacesGreedy(*pa, temp);
+				}
 				for(auto t : temp)
 					pa->sliced->collision.push_back(t);
 			}
 		}
 
 
-		for (auto cf : pa->tris)
-			delete cf;
 		pa->tris.clear();
 
-		
-		for (auto cf : pa->sliced ? pa->sliced->collision : pa->collision)
+		// Tris come straight off of the faces, cracks and all
+		// No need to wait on the convex pieces for this
+		if (pa->sliced)
+			triangluateMeshPartFaces(*pa, pa->sliced->faces, pa->tris);
+		else
 		{
-			face_t* f = new face_t;
-			cloneFaceInto(cf, f);
-			pa->tris.push_back(f);
+			std::vector<face_t*> whole = { pa };
+			triangluateMeshPartFaces(*pa, whole, pa->tris);
 		}
-
-		triangluateMeshPartConvexFaces(*pa, pa->tris);
 	}
-
-	m_renderData.RebuildRenderData();
 }
 
-void CNode::Update()
+void CNode::Render()
 {
-	
-	UpdateThisOnly();
+	if (m_instance)
+		m_instance->Render(m_mesh.origin);
+	else
+		m_renderData.Render();
+}
 
-	// Update what we're cutting
-	for (auto m : m_cutting)
+void CNode::PageOut()
+{
+	for (auto pa : m_mesh.parts)
 	{
-		m->UpdateThisOnly();
+		for (auto f : pa->collision)
+			delete f;
+		std::vector<face_t*>().swap(pa->collision);
+		std::vector<uint32_t>().swap(pa->tris);
+
+		delete pa->sliced;
+		pa->sliced = nullptr;
 	}
 
+	for (auto v : m_mesh.cutVerts)
+		delete v;
+	std::vector<glm::vec3*>().swap(m_mesh.cutVerts);
+
+	m_collisionBVH.Clear();
+	m_collisionBVHDirty = true;
+	m_renderData.FreeRenderData();
+	GetWorldEditor().ReleaseInstance(this);
+	m_state = NodeState::DORMANT;
+}
+
+// Everything but the origin
+static void freeMesh(cuttableMesh_t& mesh)
+{
+	for (auto p : mesh.parts)
+		delete p;
+	for (auto v : mesh.verts)
+		delete v;
+	for (auto v : mesh.cutVerts)
+		delete v;
+	std::vector<meshPart_t*>().swap(mesh.parts);
+	std::vector<glm::vec3*>().swap(mesh.verts);
+	std::vector<glm::vec3*>().swap(mesh.cutVerts);
+}
+
+void CNode::Pack()
+{
+	if (m_packed || m_state != NodeState::DORMANT)
+		return;
+
+	packMesh(m_mesh, m_packedMesh);
+	freeMesh(m_mesh);
+	m_packed = true;
 }
-void CNode::UpdateThisOnly()
+
+void CNode::Unpack()
+{
+	if (!m_packed)
+		return;
+
+	unpackMesh(m_packedMesh, m_mesh);
+	m_packed = false;
+}
+
+void CNode::SetPackedMesh(packedMesh_t& packed)
+{
+	SASSERT(m_state == NodeState::DORMANT);
+
+	freeMesh(m_mesh);
+	std::swap(m_packedMesh, packed);
+	m_packed = true;
+}
+
+void CNode::Recenter()
+{
+	if (m_packed)
+		recenterPackedMesh(m_packedMesh, m_mesh.origin);
+	else
+		recenterMesh(m_mesh);
+}
+
+void CNode::Update()
 {
-	recenterMesh(m_mesh);
-	PreviewUpdate();
+	GetWorldEditor().QueueUpdate(this, true);
 }
 
 
@@ -417,7 +942,7 @@ void CNode::DisconnectFrom(CNodeRef node)
 
 void CNode::CalculateAABB()
 {
-	m_aabb = meshAABB(m_mesh);
+	m_aabb = m_packed ? packedMeshAABB(m_packedMesh) : meshAABB(m_mesh);
 
 	//m_aabbLength = glm::length(m_aabb.max - m_aabb.min);
 
@@ -2,6 +2,11 @@
 #include "worldrenderer.h"
 #include "mesh.h"
 #include "meshrenderer.h"
+#include "worldbvh.h"
+#include "sweepprune.h"
+#include "facebvh.h"
+#include "meshinstance.h"
+#include "containerutil.h"
 
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
@@ -12,15 +17,19 @@
 // World References
 //  - These function as semi-safe references to objects in the world, 
 //    these allow the edit history to function without imploding.
-//  - If you need more than 65k nodes with 65k parts and 65k hes per part, please let me know
+//  - Ids are 32 bit, so the world's only as big as memory lets it be
 
-typedef uint16_t nodeId_t;
-#define MAX_NODE_ID UINT16_MAX
+typedef uint32_t nodeId_t;
+#define MAX_NODE_ID UINT32_MAX
 #define INVALID_NODE_ID MAX_NODE_ID
 
+// Node ids get reused once a node's deleted. The generation tells the old node and the new one apart
+// Part, half edge and vertex refs hold a node ref, so they go stale right along with it
+typedef uint16_t nodeGen_t;
 
-typedef uint16_t meshId_t;
-#define MAX_MESH_ID UINT16_MAX
+
+typedef uint32_t meshId_t;
+#define MAX_MESH_ID UINT32_MAX
 #define INVALID_MESH_ID MAX_MESH_ID
 
 // Safe reference to a node
@@ -29,21 +38,25 @@ class CNodeRef
 {
 public:
 	CNodeRef();
+	// Refers to whatever's using the id right now
 	CNodeRef(nodeId_t id);
+	CNodeRef(nodeId_t id, nodeGen_t generation);
 	CNodeRef(CNode* node);
 
 	bool IsValid() const;
 	nodeId_t ID() const { return m_targetId; }
+	nodeGen_t Generation() const { return m_targetGeneration; }
 	CNode* Node() const;
 
 	CNode* operator->() const;
 	void operator=(const CNodeRef& ref);
-	friend bool operator==(const CNodeRef& p1, const CNodeRef& p2) { return p1.m_targetId == p2.m_targetId; }
-	friend bool operator==(const CNodeRef* p1, const CNodeRef& p2) { return p1->m_targetId == p2.m_targetId; }
-	friend bool operator==(const CNodeRef& p1, const CNodeRef* p2) { return p1.m_targetId == p2->m_targetId; }
+	friend bool operator==(const CNodeRef& p1, const CNodeRef& p2) { return p1.m_targetId == p2.m_targetId && p1.m_targetGeneration == p2.m_targetGeneration; }
+	friend bool operator==(const CNodeRef* p1, const CNodeRef& p2) { return *p1 == p2; }
+	friend bool operator==(const CNodeRef& p1, const CNodeRef* p2) { return p1 == *p2; }
 
 private:
 	nodeId_t m_targetId;
+	nodeGen_t m_targetGeneration;
 
 };
 
@@ -53,6 +66,8 @@ class CNodeMeshPartRef
 public:
 	CNodeMeshPartRef();
 	CNodeMeshPartRef(meshPart_t* part, CNodeRef node);
+	// When we already know where the part sits, there's no need to go looking for it
+	CNodeMeshPartRef(CNodeRef node, meshId_t partId);
 
 	const bool IsValid();
 
@@ -91,6 +106,7 @@ class CNodeVertexRef
 public:
 	CNodeVertexRef();
 	CNodeVertexRef(vertex_t* vertex, CNodeRef node);
+	CNodeVertexRef(CNodeMeshPartRef part, meshId_t vertId);
 
 	bool IsValid();
 
@@ -113,8 +129,8 @@ namespace std
 	{
 		inline size_t operator()(const CNodeRef& v) const
 		{
-			std::hash<nodeId_t> hasher;
-			return hasher(v.ID());
+			std::hash<uint64_t> hasher;
+			return hasher((uint64_t)v.Generation() << 32 | v.ID());
 		}
 	};
 }
@@ -122,6 +138,18 @@ namespace std
 
 // Nodes
 
+// How much of a node is built
+// Only the mesh is ever needed to build the rest, so everything past dormant can be thrown out and built again later
+enum class NodeState
+{
+	// Just the mesh and its AABB. Enough to sit in the BVH and sweep
+	// Once paged out, even the mesh is packed down to its verts and parts. See CNode::Pack
+	DORMANT,
+	// Collision's built, so we can be traced and cut into others
+	SHAPED,
+	// Cut, tessellated and handed to bgfx. Ready to draw
+	BUILT,
+};
 
 class CNode
 {
@@ -129,10 +157,11 @@ public:
 	CNode();
 
 	void Init();
+
+	// These queue us up to be rebuilt on the next CWorldEditor::FlushUpdates, along with whatever we're cutting
+	// Preview leaves the mesh where it is. Update recenters it around the origin first
 	void PreviewUpdate();
-	void PreviewUpdateThisOnly();
 	void Update();
-	void UpdateThisOnly();
 
 	//void ConstructWalls();
 	bool IsPointInAABB(glm::vec3 point);
@@ -144,10 +173,28 @@ public:
 
 	glm::vec3 Origin() { return m_mesh.origin; }
 
+	// Rebuilt on first use after our shape changes
+	// Shapes us first if we're dormant
+	CFaceBVH& CollisionBVH();
+
+	NodeState State() { return m_state; }
+
+	// Whether our mesh is down to just m_packedMesh. Shaping us unpacks it
+	bool IsPacked() { return m_packed; }
+	// Hands us a mesh that's already packed, like when loading, in place of the one we have
+	void SetPackedMesh(packedMesh_t& packed);
+
+	// Draws us, through our instance if we share one
+	// This does not bgfx::submit!!
+	void Render();
+	// nullptr if we draw with our own render data
+	CMeshInstance* Instance() { return m_instance; }
+
 	void SetVisible(bool visible) { m_visible = visible; }
 	bool IsVisible() { return m_visible; }
 	nodeId_t NodeID() { return m_id; }
-	CNodeRef Ref() { return { m_id }; }
+	nodeGen_t NodeGeneration() { return m_generation; }
+	CNodeRef Ref() { return { m_id, m_generation }; }
 
 	void ConnectTo(CNodeRef node);
 	void DisconnectFrom(CNodeRef node);
@@ -159,9 +206,28 @@ protected:
 
 	//void LinkSides();
 	void CalculateAABB();
+
+	// The stages of a rebuild. See CWorldEditor::FlushUpdates
+	// Shape only touches this node. Cuts read the shapes of the cutters. Tessellation reads our cuts.
+	void RebuildShape();
+	void RebuildCuts(std::vector<mesh_t*>& cutters);
+	void RebuildTessellation();
+
+	// Throws out everything built off of the mesh and goes back to dormant
+	void PageOut();
+
+	// Packs the mesh down into m_packedMesh and throws out the rest of it. Only while dormant
+	void Pack();
+	// Builds the mesh back up out of m_packedMesh, if it's packed
+	void Unpack();
+
+	// Moves our origin to the middle of our verts, packed or not
+	void Recenter();
 public:
 
+	// Has no verts or parts while we're packed. The origin's always good
 	cuttableMesh_t m_mesh;
+	packedMesh_t m_packedMesh;
 	CMeshRenderer m_renderData;
 	
 	std::unordered_set<CNodeRef> m_cutting;
@@ -171,8 +237,35 @@ protected:
 	aabb_t m_aabb;
 	bool m_visible;
 	nodeId_t m_id = INVALID_NODE_ID;
+	nodeGen_t m_generation = 0;
+
+	// Where we sit in the world's BVH. -1 if we're not in it
+	int m_bvhLeaf = -1;
+
+	// Our AABB as the sweep and prune last saw it
+	aabb_t m_sweepBox;
+
+	// Over our collision faces, local to our origin. Only good while m_collisionBVHDirty is false
+	CFaceBVH m_collisionBVH;
+	bool m_collisionBVHDirty = true;
+
+	// Waiting on FlushUpdates
+	bool m_updateQueued = false;
+	bool m_recenterQueued = false;
+
+	NodeState m_state = NodeState::DORMANT;
+	bool m_packed = false;
+
+	// Who we draw through while we're uncut and shaped the same as some other node. Our own render data sits empty meanwhile
+	CMeshInstance* m_instance = nullptr;
+
+	// Set while we're in CWorldEditor::m_loneShapes, under this hash
+	bool m_lone = false;
+	uint64_t m_loneHash = 0;
 
 	friend class CWorldEditor;
+	friend class CWorldBVH;
+	friend class CSweepPrune;
 };
 
 // I've been told hammer only likes triangles and quads. How sad!
@@ -193,6 +286,12 @@ public:
 };
 */
 
+// The world's split into a grid of these for paging nodes in and out
+#define WORLD_REGION_SIZE 256.0f
+
+// How many frames a region can go without being drawn or queried before it gets paged out
+#define WORLD_REGION_IDLE_FRAMES 600
+
 
 class CWorldEditor
 {
@@ -201,24 +300,97 @@ public:
 
 	void Clear();
 
-	CNode* GetNode(nodeId_t id);
+	// Whatever's using the id right now
+	CNode* GetNode(nodeId_t id) { return m_nodes.get(id); }
+	// nullptr if the node with this id and generation is gone, even if something else has taken the id since
+	CNode* GetNode(nodeId_t id, nodeGen_t generation) { return m_nodes.get(id, generation); }
 	void RegisterNode(CNode* node);
 	
 	// Returns true on success
-	bool AssignID(CNode* node, nodeId_t id);
+	// Used to bring a node back exactly as it was, generation and all, so refs to it from before still work
+	// Pass place as false when a PlaceAll is coming right after anyway, like when loading. The node stays out of the BVH and sweep until then
+	bool AssignID(CNode* node, nodeId_t id, nodeGen_t generation = 0, bool place = true);
 	void DeleteNode(CNode* node);
 
 	CQuadNode* CreateQuad();
 	//CTriNode* CreateTri();
+
+	// Throws out everything built, then recenters every node and puts them all in the BVH and sweep at once
+	// Leaves them dormant, so nothing gets built until a view or query actually touches it. Use this after loading
+	void PlaceAll();
+
+	// Rebuilds every node in the world at once. Use this after bulk changes instead of updating nodes one by one
+	void RebuildAll();
+
+	// Builds whatever isn't yet, along with the rest of the regions they sit in. Views call this on what they're about to draw
+	void Materialise(std::vector<CNode*>& nodes);
+	// Builds every node in the world. For anything that needs all of it at once, like exporting
+	void MaterialiseAll();
+	// Just enough for a query to trace the node and read its parts
+	void MaterialiseShape(CNode* node);
+
+	// Pages out every region nothing's touched in a while. Called once a frame
+	void PageOutIdle();
+
+	// Queues node up to be rebuilt on the next FlushUpdates. Queuing it again before then costs nothing
+	void QueueUpdate(CNode* node, bool recenter);
+
+	// Rebuilds everything queued, plus everything they cut, each exactly once
+	// Shapes go first, then cuts, then tessellation, with the nodes in each stage done in parallel
+	// Called once a frame
+	void FlushUpdates();
 	
 
 //private:
-	std::unordered_map<nodeId_t, CNode*> m_nodes;
+	// Indexed by node id. Iterating runs over just the nodes, packed together
+	CSlotMap<CNode, nodeGen_t> m_nodes;
+
+	// Every node in m_nodes, by AABB. Used to cull ray tests
+	CWorldBVH m_bvh;
+
+	// Keeps track of which nodes touch, and connects them up so they cut eachother
+	CSweepPrune m_sweep;
+
+	// Nodes waiting on FlushUpdates. Refs, so anything deleted in the meantime gets skipped
+	std::vector<CNodeRef> m_updateQueue;
+
+	// Keyed by which cell of the region grid a node's center is in
+	// Every node that isn't dormant sits in a region in here
+	struct region_t
+	{
+		uint32_t lastTouched = 0;
+
+		// Everything in the region was built when it was first drawn
+		// Otherwise just a few nodes got shaped for queries or cuts
+		bool pagedIn = false;
+	};
+	std::unordered_map<uint64_t, region_t> m_regions;
+	uint32_t m_frame = 0;
+
+	uint64_t RegionKey(CNode* node);
+	aabb_t RegionBox(uint64_t key);
+	region_t& TouchRegion(CNode* node);
+
+	// Every node in the region whose center's in it
+	void FindInRegion(uint64_t key, std::vector<CNode*>& nodes);
+
+	// Shapes anything dormant in nodes, along with anything dormant that cuts them
+	void ShapeDormant(std::vector<CNode*>& nodes);
+
+	// Uncut nodes shaped exactly alike share one instance between them, keyed by meshShapeHash
+	std::unordered_map<uint64_t, std::vector<CMeshInstance*>> m_instances;
+	// The last node seen with a shape no instance has yet. Whichever node matches it next makes one for the both of them
+	std::unordered_map<uint64_t, CNodeRef> m_loneShapes;
+
+	// Hands node an instance to share if it can, or builds it its own render data if it can't
+	// The last stage of a build, on the main thread for bgfx
+	void RebuildRenderData(CNode* node);
+	// Stops node sharing, or waiting to share, anything
+	void ReleaseInstance(CNode* node);
 
-	// This lets us create unique ids
-	// Ideally, we should never decrement this, but if we never do, we'll run out of space due to edit history...
-	// TODO: somehow cull out edit history or make something better!
-	nodeId_t m_currentNodeId;
+	// Bumped whenever a node is added, removed, edited, reshaped or moved
+	// Anything caching results off of the world can check this to know when they've gone stale
+	uint32_t m_editEpoch;
 
 };
 
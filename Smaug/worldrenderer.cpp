@@ -35,15 +35,13 @@ void CWorldRenderer::Init()
 #endif
 }
 
-void CWorldRenderer::Draw2D(bgfx::ViewId viewId, Shader shader)
+void CWorldRenderer::Draw2D(bgfx::ViewId viewId, Shader shader, std::vector<CNode*>& nodes)
 {
 	bgfx::ProgramHandle shaderProgram = ShaderManager().GetShaderProgram(shader);
-	CWorldEditor& world = GetWorldEditor();
-	for (auto p : world.m_nodes)
+	for (auto node : nodes)
 	{
-		CNode* node = p.second;
 
-		node->m_renderData.Render();
+		node->Render();
 
 		// Set the color
 		// Precompute this?
@@ -53,17 +51,15 @@ void CWorldRenderer::Draw2D(bgfx::ViewId viewId, Shader shader)
 	}
 }
 
-void CWorldRenderer::Draw3D(bgfx::ViewId viewId, Shader shader)
+void CWorldRenderer::Draw3D(bgfx::ViewId viewId, Shader shader, std::vector<CNode*>& nodes)
 {
 	bgfx::ProgramHandle shaderProgram = ShaderManager().GetShaderProgram(shader);
-	CWorldEditor& world = GetWorldEditor();
-	for (auto p : GetWorldEditor().m_nodes)
+	for (auto node : nodes)
 	{
-		CNode* node = p.second;
 
 		if(node->IsVisible())
 		{
-			node->m_renderData.Render();
+			node->Render();
 
 			// Set the color
 			// Precompute this?
@@ -3,17 +3,20 @@
 #include <bgfx/bgfx.h>
 #include "shadermanager.h"
 #include <glm/vec3.hpp>
+#include <vector>
+
+class CNode;
 
 class CWorldRenderer
 {
 public:
 	void Init();
-	void Draw2D(bgfx::ViewId viewId, Shader shader);
-	void Draw3D(bgfx::ViewId viewId, Shader shader);
+	// Only draws nodes, so views can cull down to what they can actually see first
+	void Draw2D(bgfx::ViewId viewId, Shader shader, std::vector<CNode*>& nodes);
+	void Draw3D(bgfx::ViewId viewId, Shader shader, std::vector<CNode*>& nodes);
 	
 };
 
-class CNode;
 glm::vec3 nodeColor(CNode* node);
 
 CWorldRenderer& GetWorldRenderer();
\ No newline at end of file
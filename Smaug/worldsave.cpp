@@ -4,7 +4,8 @@
 #include "actionmanager.h"
 #include <KeyValue.h>
 
-static const int SAVE_FILE_VERSION = 0;
+// 1 - Ids went to 32 bit, and nodes save their generation
+static const int SAVE_FILE_VERSION = 1;
 
 
 char* saveWorld()
@@ -18,56 +19,51 @@ char* saveWorld()
 	for (auto n : GetWorldEditor().m_nodes)
 	{
 		KeyValue* node = file.AddNode("node");
-		snprintf(buf, sizeof(buf), "%d", n.first);
+		snprintf(buf, sizeof(buf), "%u", n->NodeID());
 		node->Add("id", buf);
+		snprintf(buf, sizeof(buf), "%u", n->NodeGeneration());
+		node->Add("generation", buf);
 
-		glm::vec3 origin = n.second->m_mesh.origin;
+		glm::vec3 origin = n->m_mesh.origin;
 		snprintf(buf, sizeof(buf), "%a %a %a", origin.x, origin.y, origin.z);
 		node->Add("origin", buf);
 
-		auto vertList = n.second->m_mesh.verts;
+		// Paged out nodes are already down to what we save
+		packedMesh_t packed;
+		if (!n->IsPacked())
+			packMesh(n->m_mesh, packed);
+		packedMesh_t& mesh = n->IsPacked() ? n->m_packedMesh : packed;
 
 		KeyValue* verts = node->AddNode("verts");
-		for (auto v : vertList)
+		for (auto& v : mesh.verts)
 		{
-			snprintf(buf, sizeof(buf), "%a %a %a", v->x, v->y, v->z);
+			snprintf(buf, sizeof(buf), "%a %a %a", v.x, v.y, v.z);
 			verts->Add("vert", buf);
 		}
 
 		KeyValue* parts = node->AddNode("parts");
-		for (auto p : n.second->m_mesh.parts)
+		size_t next = 0;
+		for (auto size : mesh.partSizes)
 		{
-			if (p->verts.size() == 0)
+			if (size == 0)
 				continue;
 
-			vertex_t* v = p->verts.front(), *vs = v;
-			do
+			for (uint32_t i = 0; i < size; i++)
 			{
-				int idx = 0;
-				auto find = std::find(vertList.begin(), vertList.end(), v->vert);
-				if (find == vertList.end())
-				{
-					Log::Fault("[WorldSave] Failed to find mesh part vertex!\n");
-				}
-				else
-				{
-					idx = find - vertList.begin();
-				}
+				uint32_t idx = mesh.indices[next++];
 
 				// For our first element, we don't want any spaces
-				if (v == vs)
+				if (i == 0)
 				{
-					snprintf(buf, sizeof(buf), "%d", idx);
+					snprintf(buf, sizeof(buf), "%u", idx);
 				}
 				else
 				{
 					char idxBuf[32];
-					snprintf(idxBuf, sizeof(idxBuf), " %d", idx);
+					snprintf(idxBuf, sizeof(idxBuf), " %u", idx);
 					strcat(buf, idxBuf);
 				}
-
-				v = v->edge->vert;
-			} while (v != vs);
+			}
 			
 			parts->Add("part", buf);
 		}
@@ -80,10 +76,8 @@ char* saveWorld()
 
 
 // This is lame!
-void loadWorld(char* input)
+void parseWorld(char* input, std::vector<savedNode_t>& savedNodes)
 {
-	resetWorld();
-
 	KeyValueRoot kvFile(input);
 
 	for (KeyValue* kvNode = kvFile.children; kvNode; kvNode = kvNode->next)
@@ -91,11 +85,12 @@ void loadWorld(char* input)
 
 		if (strncmp(kvNode->key.string, "node", kvNode->key.length) == 0)
 		{
-			
-			std::vector<glm::vec3> verts;
-			std::vector<std::vector<int>> parts;
-			int id = 0;
-			glm::vec3 origin{0,0,0};
+			savedNode_t& saved = savedNodes.emplace_back();
+			std::vector<glm::vec3>& verts = saved.verts;
+			std::vector<std::vector<int>>& parts = saved.parts;
+			uint32_t& id = saved.id;
+			uint32_t& generation = saved.generation;
+			glm::vec3& origin = saved.origin;
 
 			// Suck data for each node
 			for (KeyValue* kv = kvNode->children; kv; kv = kv->next)
@@ -143,7 +138,13 @@ void loadWorld(char* input)
 				{
 					if (strncmp(kv->key.string, "id", kv->key.length) == 0)
 					{
-						id = strtol(kv->value.string, nullptr, 10);
+						id = strtoul(kv->value.string, nullptr, 10);
+					}
+
+					// Version 0 saves don't have these. 0 is fine for them
+					if (strncmp(kv->key.string, "generation", kv->key.length) == 0)
+					{
+						generation = strtoul(kv->value.string, nullptr, 10);
 					}
 
 					if (strncmp(kv->key.string, "origin", kv->key.length) == 0)
@@ -156,44 +157,57 @@ void loadWorld(char* input)
 				}
 
 			}
+		}
+	}
+}
 
-			// Create the node out of the data we snatched
-			if (parts.size() != 0 && verts.size() != 0)
-			{
-				CNode* node = new CNode();
+void loadWorld(char* input)
+{
+	resetWorld();
 
-				node->m_mesh.origin = origin;
+	// Parse everything first, so we can build the whole world in one go afterwards
+	std::vector<savedNode_t> savedNodes;
+	parseWorld(input, savedNodes);
 
-				auto& vertList = node->m_mesh.verts;
-				for (auto v : verts)
-					vertList.push_back(new glm::vec3{v});
-				for (auto p : parts)
+	for (auto& saved : savedNodes)
+	{
+		// Create the node out of the data we snatched
+		if (saved.parts.size() != 0 && saved.verts.size() != 0)
+		{
+			CNode* node = new CNode();
+
+			node->m_mesh.origin = saved.origin;
+
+			// Nodes load straight in packed. Their half edges only get built once something looks at them
+			packedMesh_t packed;
+			packed.verts = std::move(saved.verts);
+			packed.partSizes.reserve(saved.parts.size());
+			for (auto& p : saved.parts)
+			{
+				packed.partSizes.push_back(p.size());
+				for (auto v : p)
 				{
-					std::vector<glm::vec3*> faceVerts;
-					for (auto v : p)
+					if (v < 0 || (size_t)v >= packed.verts.size())
 					{
-						if (v >= vertList.size())
-						{
-							Log::Fault("[LoadWorld] Malformed part!\n");
-						}
-						faceVerts.push_back(vertList[v]);
+						Log::Fault("[LoadWorld] Malformed part!\n");
 					}
-					addMeshFace(node->m_mesh, faceVerts.data(), faceVerts.size());
+					packed.indices.push_back(v);
 				}
-
-				node->Init();
-
-				GetWorldEditor().AssignID(node, id);
-			}
-			else
-			{
-				Log::Fault("[LoadWorld] Empty Node!\n");
 			}
+			node->SetPackedMesh(packed);
+
+			// PlaceAll puts everything in the BVH and sweep at once below. Inserting them one by one here would be quadratic
+			GetWorldEditor().AssignID(node, saved.id, saved.generation, false);
+		}
+		else
+		{
+			Log::Fault("[LoadWorld] Empty Node!\n");
 		}
 	}
 
-	for (auto n : GetWorldEditor().m_nodes)
-		n.second->UpdateThisOnly();
+	// Place all of the nodes at once now that they're all in
+	// None of them get built until something actually looks at them
+	GetWorldEditor().PlaceAll();
 
 }
 
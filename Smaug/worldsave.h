@@ -1,7 +1,23 @@
 #pragma once
 
+#include <glm/vec3.hpp>
+#include <vector>
+#include <cstdint>
+
+// Everything we need to make a node
+struct savedNode_t
+{
+	std::vector<glm::vec3> verts;
+	std::vector<std::vector<int>> parts;
+	uint32_t id = 0;
+	uint32_t generation = 0;
+	glm::vec3 origin{ 0,0,0 };
+};
 
 char* saveWorld();
 void loadWorld(char* input);
 void resetWorld();
-void defaultWorld();
\ No newline at end of file
+void defaultWorld();
+
+// Pulls every node out of a save without touching the world
+void parseWorld(char* input, std::vector<savedNode_t>& savedNodes);
\ No newline at end of file